@@ -0,0 +1,55 @@
+create table if not exists archive.sessions
+(
+    id                 integer  not null primary key,
+    startTime          datetime not null,
+    fee                integer  not null,
+    numPlayersPerCourt integer  not null,
+    place              text     not null,
+    announcement       text
+);
+---
+create table if not exists archive.courts
+(
+    id        integer not null primary key,
+    sessionId integer not null,
+    name      text    not null,
+    sortOrder integer not null
+);
+---
+create index if not exists archive.archive_courts_sessions on courts (sessionId);
+---
+create table if not exists archive.players
+(
+    id           integer  not null primary key,
+    sessionId    integer  not null,
+    memberId     integer  not null,
+    paid         boolean  not null,
+    checkInTime  datetime not null,
+    checkOutTime datetime,
+    paused       boolean  not null
+);
+---
+create index if not exists archive.archive_players_sessions on players (sessionId, memberId);
+---
+create index if not exists archive.archive_players_members on players (memberId);
+---
+create table if not exists archive.games
+(
+    id              integer  not null primary key,
+    sessionId       integer  not null,
+    startTime       datetime not null,
+    durationSeconds integer  not null
+);
+---
+create index if not exists archive.archive_games_sessions on games (sessionId, id);
+---
+create table if not exists archive.game_allocations
+(
+    gameId   integer not null,
+    courtId  integer not null,
+    playerId integer not null,
+    quality  integer default 0,
+    primary key (gameId, courtId, playerId)
+);
+---
+create index if not exists archive.archive_game_allocations_players on game_allocations (playerId);
@@ -0,0 +1,34 @@
+create temp view if not exists all_sessions as
+select id, startTime, fee, numPlayersPerCourt, place, announcement
+from main.sessions
+union all
+select id, startTime, fee, numPlayersPerCourt, place, announcement
+from archive.sessions;
+---
+create temp view if not exists all_courts as
+select id, sessionId, name, sortOrder
+from main.courts
+union all
+select id, sessionId, name, sortOrder
+from archive.courts;
+---
+create temp view if not exists all_players as
+select id, sessionId, memberId, paid, checkInTime, checkOutTime, paused
+from main.players
+union all
+select id, sessionId, memberId, paid, checkInTime, checkOutTime, paused
+from archive.players;
+---
+create temp view if not exists all_games as
+select id, sessionId, startTime, durationSeconds
+from main.games
+union all
+select id, sessionId, startTime, durationSeconds
+from archive.games;
+---
+create temp view if not exists all_game_allocations as
+select gameId, courtId, playerId, quality
+from main.game_allocations
+union all
+select gameId, courtId, playerId, quality
+from archive.game_allocations;
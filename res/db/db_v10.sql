@@ -0,0 +1,41 @@
+update settings
+set value = 10
+where name = 'schema_version';
+---
+alter table players add column gamesPlayed integer not null default 0;
+---
+alter table players add column lastGameId integer;
+---
+alter table players add column lastPlayedAt datetime;
+---
+update players
+set gamesPlayed = (select count(*) from game_allocations GA where GA.playerId = players.id),
+    lastGameId  = (select max(GA.gameId) from game_allocations GA where GA.playerId = players.id);
+---
+update players
+set lastPlayedAt = (select G.startTime from games G where G.id = players.lastGameId)
+where lastGameId is not null;
+---
+create trigger player_counters_insert
+    after insert
+    on game_allocations
+begin
+    update players
+    set gamesPlayed  = gamesPlayed + 1,
+        lastGameId   = max(coalesce(lastGameId, new.gameId), new.gameId),
+        lastPlayedAt = (select G.startTime from games G where G.id = max(coalesce(lastGameId, new.gameId), new.gameId))
+    where id = new.playerId;
+end;
+---
+create trigger player_counters_delete
+    after delete
+    on game_allocations
+begin
+    update players
+    set gamesPlayed  = gamesPlayed - 1,
+        lastGameId   = (select max(GA.gameId) from game_allocations GA where GA.playerId = old.playerId),
+        lastPlayedAt = (select G.startTime
+                        from games G
+                        where G.id = (select max(GA.gameId) from game_allocations GA where GA.playerId = old.playerId))
+    where id = old.playerId;
+end;
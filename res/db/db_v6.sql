@@ -0,0 +1,22 @@
+update settings
+set value = 6
+where name = 'schema_version';
+---
+create table member_pair_history
+(
+    pairKey    integer  not null primary key,
+    numGames   integer  not null default 0,
+    lastPlayed datetime not null default current_timestamp
+);
+---
+insert into member_pair_history (pairKey, numGames, lastPlayed)
+select (min(P1.memberId, P2.memberId) << 32) | max(P1.memberId, P2.memberId) as pairKey,
+       count(*),
+       max(G.startTime)
+from game_allocations GA1
+         inner join game_allocations GA2
+                    on GA2.gameId = GA1.gameId and GA2.courtId = GA1.courtId and GA2.playerId > GA1.playerId
+         inner join games G on G.id = GA1.gameId
+         inner join players P1 on P1.id = GA1.playerId
+         inner join players P2 on P2.id = GA2.playerId
+group by pairKey
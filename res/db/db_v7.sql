@@ -0,0 +1,11 @@
+update settings
+set value = 7
+where name = 'schema_version';
+---
+drop index if exists game_sessions;
+---
+create index game_sessions_ids on games (sessionId, id);
+---
+drop index if exists game_allocations_games;
+---
+create index game_allocations_covering on game_allocations (gameId, courtId, playerId, quality);
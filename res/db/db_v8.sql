@@ -0,0 +1,54 @@
+update settings
+set value = 8
+where name = 'schema_version';
+---
+drop index if exists player_sessions;
+---
+create index players_session_status on players (sessionId, checkOutTime, paused, memberId, paid);
+---
+drop view session_members;
+---
+drop view checked_in_non_paused_members;
+---
+drop view paused_members;
+---
+drop view unchecked_in_members;
+---
+create view session_members as
+select M.*,
+       p.paid,
+       (case
+            when (p.checkOutTime is not null) then 'CheckedOut'
+            when p.paused then 'CheckedInPaused'
+            else 'CheckedIn'
+           end)                                        as status,
+       p.sessionId
+from players p
+         inner join normalized_members m on m.id = p.memberId;
+---
+create view checked_in_non_paused_members as
+select M.*,
+       p.paid,
+       'CheckedIn' as status,
+       p.sessionId
+from players p
+         inner join normalized_members m on m.id = p.memberId
+where p.checkOutTime is null and p.paused = 0;
+---
+create view paused_members as
+select M.*,
+       p.paid,
+       'CheckedInPaused' as status,
+       p.sessionId
+from players p
+         inner join normalized_members m on m.id = p.memberId
+where p.checkOutTime is null and p.paused = 1;
+---
+create view unchecked_in_members as
+select M.*,
+       false as paid,
+       'NotCheckedIn' as status,
+       S.id as sessionId
+from sessions S
+         cross join normalized_members M
+where not exists(select 1 from players P where P.sessionId = S.id and P.memberId = M.id)
@@ -0,0 +1,19 @@
+update settings
+set value = 9
+where name = 'schema_version';
+---
+drop trigger if exists check_member_duplication_i;
+---
+drop trigger if exists check_member_duplication_u;
+---
+update members
+set lastName = lastName || ' (' || id || ')'
+where exists(select 1
+             from members M
+             where lower(trim(M.firstName)) = lower(trim(members.firstName))
+               and lower(trim(M.lastName)) = lower(trim(members.lastName))
+               and M.id < members.id);
+---
+drop index if exists member_unique_names;
+---
+create unique index member_normalized_names on members (lower(trim(firstName)), lower(trim(lastName)));
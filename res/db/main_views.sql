@@ -0,0 +1,29 @@
+drop view if exists temp.all_sessions;
+---
+create temp view all_sessions as
+select id, startTime, fee, numPlayersPerCourt, place, announcement
+from main.sessions;
+---
+drop view if exists temp.all_courts;
+---
+create temp view all_courts as
+select id, sessionId, name, sortOrder
+from main.courts;
+---
+drop view if exists temp.all_players;
+---
+create temp view all_players as
+select id, sessionId, memberId, paid, checkInTime, checkOutTime, paused
+from main.players;
+---
+drop view if exists temp.all_games;
+---
+create temp view all_games as
+select id, sessionId, startTime, durationSeconds
+from main.games;
+---
+drop view if exists temp.all_game_allocations;
+---
+create temp view all_game_allocations as
+select gameId, courtId, playerId, quality
+from main.game_allocations;
@@ -107,6 +107,8 @@ BFCombinationFinder::doFind(const QVector<PlayerInfo> &span, unsigned numCourtAv
         }
     }
 
+    if (*minLevel == *maxLevel) (*maxLevel)++;
+
     QVector<CourtAllocation> result;
     BestCourtFinder finder(numPlayersPerCourt_, stats_, *minLevel, *maxLevel);
 
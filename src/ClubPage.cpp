@@ -8,9 +8,11 @@
 #include "ClubRepository.h"
 #include "SessionPage.h"
 #include "EmptySessionPage.h"
+#include "QueryDiagnosticsDialog.h"
 
 #include <QDialog>
 #include <QMessageBox>
+#include <QShortcut>
 #include <QStackedLayout>
 
 struct ClubPage::Impl {
@@ -32,6 +34,13 @@ ClubPage::ClubPage(ClubRepository *repo, QWidget *parent)
     connect(page, &EmptySessionPage::clubClosed, this, &ClubPage::clubClosed);
     d->layout->addWidget(page);
 
+    // Hidden on purpose, it's for looking into slow databases rather than running a session
+    auto diagnostics = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_D), this);
+    diagnostics->setContext(Qt::WindowShortcut);
+    connect(diagnostics, &QShortcut::activated, [=] {
+        (new QueryDiagnosticsDialog(d->repo, this))->show();
+    });
+
     setWindowTitle(repo->getClubName());
 }
 
@@ -3,14 +3,30 @@
 
 #include <QFile>
 #include <QByteArray>
+#include <QCache>
 #include <QSqlResult>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QTimer>
+#include <QThreadPool>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInteger>
+#include <QPointer>
 
 
 #include "DbUtils.h"
+#include "TypeUtils.h"
 #include "NameFormatUtils.h"
+#include "CoPlayHistory.h"
+#include "SessionSnapshot.h"
+#include "QueryProfiler.h"
+
+#include <cmath>
+#include <memory>
 
 using namespace sqlx;
 
@@ -23,6 +39,11 @@ static struct {
         {3, QStringLiteral(":/sql/db_v3.sql")},
         {4, QStringLiteral(":/sql/db_v4.sql")},
         {5, QStringLiteral(":/sql/db_v5.sql")},
+        {6, QStringLiteral(":/sql/db_v6.sql")},
+        {7, QStringLiteral(":/sql/db_v7.sql")},
+        {8, QStringLiteral(":/sql/db_v8.sql")},
+        {9, QStringLiteral(":/sql/db_v9.sql")},
+        {10, QStringLiteral(":/sql/db_v10.sql")},
 };
 
 static const SettingKey skClubName = QStringLiteral("club_name");
@@ -32,6 +53,86 @@ static const SettingKey skLevelMax = QStringLiteral("level_max");
 static const unsigned defaultLevelMin = 1;
 static const unsigned defaultLevelMax = 5;
 
+static const int maxCachedStatements = 64;
+
+// Sessions that started this many months ago are moved to the archive during maintenance, 0 keeps them all
+static const SettingKey skArchiveAfterMonths = QStringLiteral("archive_after_months");
+static const int defaultArchiveAfterMonths = 0;
+
+// Everything played in the sessions listed in temp.archiving_sessions, copied into the archive. Rows already
+// there are replaced, so copying again after an interrupted archive does no harm.
+static const QString copyToArchiveSqls[] = {
+        QStringLiteral("insert or replace into archive.sessions (id, startTime, fee, numPlayersPerCourt, place, announcement) "
+                       "select id, startTime, fee, numPlayersPerCourt, place, announcement from main.sessions "
+                       "where id in (select id from temp.archiving_sessions)"),
+        QStringLiteral("insert or replace into archive.courts (id, sessionId, name, sortOrder) "
+                       "select id, sessionId, name, sortOrder from main.courts "
+                       "where sessionId in (select id from temp.archiving_sessions)"),
+        QStringLiteral("insert or replace into archive.players (id, sessionId, memberId, paid, checkInTime, checkOutTime, paused) "
+                       "select id, sessionId, memberId, paid, checkInTime, checkOutTime, paused from main.players "
+                       "where sessionId in (select id from temp.archiving_sessions)"),
+        QStringLiteral("insert or replace into archive.games (id, sessionId, startTime, durationSeconds) "
+                       "select id, sessionId, startTime, durationSeconds from main.games "
+                       "where sessionId in (select id from temp.archiving_sessions)"),
+        QStringLiteral("insert or replace into archive.game_allocations (gameId, courtId, playerId, quality) "
+                       "select GA.gameId, GA.courtId, GA.playerId, GA.quality from main.game_allocations GA "
+                       "inner join main.games G on G.id = GA.gameId "
+                       "where G.sessionId in (select id from temp.archiving_sessions)"),
+};
+
+// And then taken out of the club's own file
+static const QString deleteArchivedSqls[] = {
+        QStringLiteral("delete from main.game_allocations where gameId in "
+                       "(select id from main.games where sessionId in (select id from temp.archiving_sessions))"),
+        QStringLiteral("delete from main.games where sessionId in (select id from temp.archiving_sessions)"),
+        QStringLiteral("delete from main.players where sessionId in (select id from temp.archiving_sessions)"),
+        QStringLiteral("delete from main.courts where sessionId in (select id from temp.archiving_sessions)"),
+        QStringLiteral("delete from main.sessions where id in (select id from temp.archiving_sessions)"),
+};
+
+// SQLite's default limit on bound variables in one statement
+static const int maxBoundVariables = 999;
+
+static QString placeholders(int numRows, const QString &row) {
+    QStringList rows;
+    rows.reserve(numRows);
+    for (int i = 0; i < numRows; i++) {
+        rows.append(row);
+    }
+    return rows.join(QStringLiteral(", "));
+}
+
+// After this many days, the number of games a pair has played together counts half as much
+static const qreal coPlayHalfLifeDays = 28;
+
+static const auto pairsOfGameSql = QStringLiteral(
+        "select (min(P1.memberId, P2.memberId) << 32) | max(P1.memberId, P2.memberId) as pairKey "
+        "from game_allocations GA1 "
+        "inner join game_allocations GA2 "
+        "on GA2.gameId = GA1.gameId and GA2.courtId = GA1.courtId and GA2.playerId > GA1.playerId "
+        "inner join players P1 on P1.id = GA1.playerId "
+        "inner join players P2 on P2.id = GA2.playerId "
+        "where GA1.gameId = ?");
+
+static const auto pairsOfPlayerSql = QStringLiteral(
+        "select (min(P1.memberId, P2.memberId) << 32) | max(P1.memberId, P2.memberId) as pairKey "
+        "from players P1 "
+        "inner join game_allocations GA1 on GA1.playerId = P1.id "
+        "inner join game_allocations GA2 "
+        "on GA2.gameId = GA1.gameId and GA2.courtId = GA1.courtId and GA2.playerId != GA1.playerId "
+        "inner join players P2 on P2.id = GA2.playerId "
+        "where P1.sessionId = ? and P1.memberId = ?");
+
+static const auto pairsOfSessionSql = QStringLiteral(
+        "select (min(P1.memberId, P2.memberId) << 32) | max(P1.memberId, P2.memberId) as pairKey "
+        "from games G "
+        "inner join game_allocations GA1 on GA1.gameId = G.id "
+        "inner join game_allocations GA2 "
+        "on GA2.gameId = GA1.gameId and GA2.courtId = GA1.courtId and GA2.playerId > GA1.playerId "
+        "inner join players P1 on P1.id = GA1.playerId "
+        "inner join players P2 on P2.id = GA2.playerId "
+        "where G.sessionId = ?");
+
 class SQLTransaction {
     QSqlDatabase &db_;
     bool rollback_ = false;
@@ -51,26 +152,670 @@ public:
     }
 };
 
+// Every connection gets a name of its own, so repositories and their readers never take over each other's
+static QString newConnectionName(const QString &prefix) {
+    static QAtomicInteger<quint64> numConnections;
+    return QStringLiteral("%1_%2").arg(prefix).arg(numConnections.fetchAndAddRelaxed(1));
+}
+
 struct ClubRepository::Impl {
-    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"));
+    QSqlDatabase db;
+
+    explicit Impl(const QString &connectionName)
+            : db(QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName)) {}
+
+    // Reads handed off with readAsync run on this single thread
+    std::unique_ptr<QThreadPool> readPool;
+    QString path;
+
+    // Read only repositories, one per thread that has asked for one. A reader is closed on its own thread
+    // when that thread finishes, which can be after this repository is gone, so they're kept apart from it.
+    struct ThreadReaders {
+        struct Reader {
+            ClubRepository *repository = nullptr;
+            QMetaObject::Connection threadFinished;
+        };
+        QMutex lock;
+        QHash<QThread *, Reader> readers;
+
+        // Only ever called on the reader's own thread, a connection can't be closed from any other
+        void close(QThread *thread) {
+            Reader reader;
+            {
+                QMutexLocker locker(&lock);
+                reader = readers.take(thread);
+            }
+            QObject::disconnect(reader.threadFinished);
+            delete reader.repository;
+        }
+    };
+    std::shared_ptr<ThreadReaders> threadReaders = std::make_shared<ThreadReaders>();
+
+    // Prepared statements keyed by their SQL text, so SQLite doesn't parse and plan the same query every call.
+    // Some SQL is built per call (placeholder lists, search terms), so only the most recently used are kept.
+    QCache<QString, QSqlQuery> statements{maxCachedStatements};
+    bool statementCacheEnabled = true;
+    StatementCacheStats statementCacheStats;
+
+    // Times the query for the profiler, and works out its plan if it's slow and that's been asked for
+    QueryProfiler::Scope profile(const QString &sql, const QVector<QVariant> &args) {
+        std::function<QStringList()> explain;
+        if (QueryProfiler::instance().explainSlowQueries()) {
+            explain = [this, sql, args] { return explainQueryPlan(sql, args); };
+        }
+        return QueryProfiler::Scope(sql, args.size(), std::move(explain));
+    }
+
+    // The query returned has to be finished before the same SQL is run again. It isn't timed here, as most of
+    // a query's time goes into reading its rows: callers wrap it and the reading in profile().
+    std::optional<QSqlQuery> exec(const QString &sql, const QVector<QVariant> &args) {
+        QSqlQuery query;
+        if (auto found = statementCacheEnabled ? statements.object(sql) : nullptr) {
+            query = *found;
+            statementCacheStats.hits++;
+        } else {
+            statementCacheStats.misses++;
+            query = QSqlQuery(db);
+            if (!query.prepare(sql)) {
+                qWarning() << "Error preparing sql " << sql << ":" << query.lastError();
+                return std::nullopt;
+            }
+
+            if (statementCacheEnabled) statements.insert(sql, new QSqlQuery(query));
+        }
+
+        for (int i = 0, size = args.size(); i < size; i++) {
+            query.bindValue(i, args[i]);
+        }
+
+        if (!query.exec()) {
+            qWarning() << "Error executing sql " << sql << ":" << query.lastError();
+            query.finish();
+            return std::nullopt;
+        }
+
+        return query;
+    }
+
+    template<typename T>
+    static bool readRecord(T &out, const QSqlRecord &record) {
+        if constexpr (HasMetaObject<T, const QMetaObject>::value) {
+            return DbUtils::readFrom(out, record);
+        } else {
+            auto value = record.value(0);
+            if (!value.canConvert<T>()) return false;
+            out = value.value<T>();
+            return true;
+        }
+    }
+
+    template<typename T>
+    std::optional<T> queryFirst(const QString &sql, const QVector<QVariant> &args = {}) {
+        auto profiled = profile(sql, args);
+        auto query = exec(sql, args);
+        if (!query) return std::nullopt;
+
+        std::optional<T> result;
+        if (query->next() && !readRecord(result.emplace(), query->record())) {
+            result.reset();
+        }
+        profiled.setNumRows(result ? 1 : 0);
+
+        query->finish();
+        return result;
+    }
+
+    template<typename T>
+    std::optional<QVector<T>> queryList(const QString &sql, const QVector<QVariant> &args = {}) {
+        auto profiled = profile(sql, args);
+        auto query = exec(sql, args);
+        if (!query) return std::nullopt;
+
+        QVector<T> result;
+        while (query->next()) {
+            result.push_back(T());
+            if (!readRecord(result.last(), query->record())) {
+                query->finish();
+                return std::nullopt;
+            }
+        }
+        profiled.setNumRows(result.size());
+
+        query->finish();
+        return result;
+    }
+
+    // For statements that write, whose rows affected are what the profiler records
+    std::optional<int> update(const QString &sql, const QVector<QVariant> &args = {}) {
+        auto profiled = profile(sql, args);
+        auto query = exec(sql, args);
+        if (!query) return std::nullopt;
+
+        auto numRowsAffected = query->numRowsAffected();
+        profiled.setNumRows(numRowsAffected);
+        query->finish();
+        return numRowsAffected;
+    }
+
+    template<typename T>
+    std::optional<T> insert(const QString &sql, const QVector<QVariant> &args = {}) {
+        auto profiled = profile(sql, args);
+        auto query = exec(sql, args);
+        if (!query) return std::nullopt;
+
+        auto id = query->lastInsertId();
+        profiled.setNumRows(query->numRowsAffected());
+        query->finish();
+        if (!id.canConvert<T>()) return std::nullopt;
+        return id.value<T>();
+    }
+
+    bool insertGameAllocations(SessionId sessionId, GameId gameId, const QVector<GameAllocation> &allocations) {
+        // Look up all the player ids at once instead of a sub-select for every row
+        QHash<MemberId, qlonglong> playerIds;
+        const int maxMembersPerQuery = maxBoundVariables - 1;
+        for (int start = 0, size = allocations.size(); start < size; start += maxMembersPerQuery) {
+            const auto numMembers = std::min(maxMembersPerQuery, size - start);
+            QVector<QVariant> args = {sessionId};
+            for (int i = start; i < start + numMembers; i++) {
+                args.push_back(allocations[i].memberId);
+            }
+
+            const auto sql = QStringLiteral("select memberId, id from players where sessionId = ? and memberId in (%1)")
+                    .arg(placeholders(numMembers, QStringLiteral("?")));
+            auto profiled = profile(sql, args);
+            auto query = exec(sql, args);
+            if (!query) return false;
+
+            int numRows = 0;
+            while (query->next()) {
+                numRows++;
+                playerIds.insert(query->value(0).value<MemberId>(), query->value(1).toLongLong());
+            }
+            profiled.setNumRows(numRows);
+            query->finish();
+        }
+
+        const int numColumns = 4;
+        const int maxRowsPerInsert = maxBoundVariables / numColumns;
+        for (int start = 0, size = allocations.size(); start < size; start += maxRowsPerInsert) {
+            const auto numRows = std::min(maxRowsPerInsert, size - start);
+            QVector<QVariant> args;
+            args.reserve(numRows * numColumns);
+            for (int i = start; i < start + numRows; i++) {
+                const auto &ga = allocations[i];
+                auto playerId = playerIds.constFind(ga.memberId);
+                if (playerId == playerIds.constEnd()) {
+                    qWarning() << "Member " << ga.memberId << " is not in session " << sessionId;
+                    return false;
+                }
+
+                args << gameId << ga.courtId << *playerId << ga.quality;
+            }
+
+            if (update(QStringLiteral("insert into game_allocations (gameId, courtId, playerId, quality) values %1")
+                               .arg(placeholders(numRows, QStringLiteral("(?, ?, ?, ?)"))), args)
+                        .value_or(0) != numRows) {
+                return false;
+            }
+        }
+
+        return static_cast<bool>(update(
+                QStringLiteral("insert into member_pair_history (pairKey, numGames, lastPlayed) "
+                               "select pairKey, 1, current_timestamp from (%1) where true "
+                               "on conflict (pairKey) do update set "
+                               "numGames = numGames + 1, lastPlayed = excluded.lastPlayed").arg(pairsOfGameSql),
+                {gameId}));
+    }
+
+    bool memberSearchAvailable = false;
+
+    // False when there's no archive attached, the all_* views then read the club's own tables alone
+    bool archiveAvailable = false;
+
+    // Lists the sessions picked by `sql` in temp.archiving_sessions, returning how many there are
+    std::optional<int> selectArchivingSessions(const QString &sql, const QVector<QVariant> &args) {
+        QSqlQuery q(db);
+        if (!q.exec(QStringLiteral("create temp table if not exists archiving_sessions (id integer primary key)")) ||
+            !q.exec(QStringLiteral("delete from temp.archiving_sessions"))) {
+            qWarning() << "Unable to list sessions to archive:" << q.lastError();
+            return std::nullopt;
+        }
+
+        if (!update(QStringLiteral("insert into temp.archiving_sessions (id) ") + sql, args)) return std::nullopt;
+        return queryFirst<int>(QStringLiteral("select count(*) from temp.archiving_sessions"));
+    }
+
+    // Runs the archiving statements over the listed sessions, in the caller's transaction
+    bool execArchiveSqls(const QString *sqls, size_t numSqls) {
+        QSqlQuery q(db);
+        for (size_t i = 0; i < numSqls; i++) {
+            if (!q.exec(sqls[i])) {
+                qWarning() << "Error executing sql " << sqls[i] << ":" << q.lastError();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool copyToArchive() {
+        return execArchiveSqls(copyToArchiveSqls, sizeof(copyToArchiveSqls) / sizeof(copyToArchiveSqls[0]));
+    }
+
+    bool deleteArchived() {
+        return execArchiveSqls(deleteArchivedSqls, sizeof(deleteArchivedSqls) / sizeof(deleteArchivedSqls[0]));
+    }
+
+    // One line per step of the plan SQLite picks for the query
+    QStringList explainQueryPlan(const QString &sql, const QVector<QVariant> &args) {
+        // Run once for a slow query, not worth a place in the statement cache
+        QStringList plan;
+        QSqlQuery query(db);
+        if (!query.prepare(QStringLiteral("explain query plan ") + sql)) return plan;
+        for (int i = 0, size = args.size(); i < size; i++) {
+            query.bindValue(i, args[i]);
+        }
+        if (!query.exec()) return plan;
+
+        while (query.next()) {
+            plan.append(query.value(QStringLiteral("detail")).toString());
+        }
+        return plan;
+    }
+
+    // Changes recorded since the last changesFlushed, sent in one go from the event loop
+    ChangeSet pendingChanges;
+    QTimer flushTimer;
+    ChangeNotificationStats changeStats;
+
+    void recordChange(const std::function<void(ChangeSet &)> &change) {
+        change(pendingChanges);
+        changeStats.numChanges++;
+        if (!flushTimer.isActive()) flushTimer.start();
+    }
+
+    // Every setting as stored, loaded at open and written through. Typed reads keep their converted
+    // value until the setting changes. Readers go to the database, as the writes happen elsewhere.
+    struct SettingsCache {
+        QHash<SettingKey, QString> values;
+        QHash<SettingKey, QHash<int, std::optional<QVariant>>> typedValues;
+    };
+    std::optional<SettingsCache> settings;
+
+    bool loadSettings() {
+        QSqlQuery q(db);
+        if (!q.exec(QStringLiteral("select name, value from settings"))) {
+            qWarning() << "Unable to load settings, reading them from the database instead:" << q.lastError();
+            settings.reset();
+            return false;
+        }
+
+        SettingsCache cache;
+        while (q.next()) {
+            cache.values.insert(q.value(0).toString(), q.value(1).toString());
+        }
+        settings = std::move(cache);
+        return true;
+    }
+
+    // Stats already worked out, by session and member. Our own game and check in changes drop those of the
+    // session. Writes from other connections show up in data_version and drop the lot, which is only
+    // looked at when there are other connections, before a cached entry is handed out.
+    QHash<QPair<SessionId, MemberId>, MemberGameStats> gameStats;
+    qlonglong gameStatsDataVersion = -1;
+
+    // Whether other connections can write to the database: the repository of a club on disk, and its readers
+    bool sharedDatabase = false;
+
+    qlonglong dataVersion() {
+        return queryFirst<qlonglong>(QStringLiteral("pragma data_version")).value_or(-1);
+    }
+
+    void forgetGameStats(SessionId sessionId) {
+        for (auto i = gameStats.begin(); i != gameStats.end();) {
+            if (i.key().first == sessionId) i = gameStats.erase(i);
+            else ++i;
+        }
+    }
+
+    // The session currently on display, kept up to date with our own changes
+    std::optional<SessionSnapshot> snapshot;
+    bool snapshotEnabled = true;
+
+    SessionSnapshot *cachedSnapshot(SessionId sessionId) {
+        return snapshot && snapshot->sessionId == sessionId ? &*snapshot : nullptr;
+    }
+
+    SessionSnapshot *snapshotOf(SessionId sessionId) {
+        if (!snapshotEnabled) return nullptr;
+        if (auto cached = cachedSnapshot(sessionId)) return cached;
+
+        SessionSnapshot loaded;
+        loaded.sessionId = sessionId;
+
+        auto courts = queryList<Court>(
+                QStringLiteral("select * from courts where sessionId = ? order by sortOrder, id"), {sessionId});
+        auto members = queryList<Member>(
+                QStringLiteral("select * from session_members where sessionId = ? order by firstName, lastName"),
+                {sessionId});
+        if (!courts || !members) return nullptr;
+
+        loaded.courts = *courts;
+        loaded.setMembers(*members);
+        if (!loadLastGame(loaded)) return nullptr;
+
+        snapshot = std::move(loaded);
+        return &*snapshot;
+    }
+
+    bool loadLastGame(SessionSnapshot &s) {
+        s.lastGame.reset();
+
+        auto game = queryFirst<GameInfo>(
+                QStringLiteral(
+                        "select id, cast(strftime('%s',startTime) as integer) as startTime, durationSeconds from games "
+                        "where sessionId = ? "
+                        "order by startTime desc, id desc limit 1"),
+                {s.sessionId});
+        if (!game) return true;
+
+        static const auto sql = QStringLiteral("select GA.courtId, GA.quality, P.memberId from game_allocations GA "
+                                               "inner join players P on P.id = GA.playerId "
+                                               "inner join courts C on C.id = GA.courtId "
+                                               "where GA.gameId = ? "
+                                               "order by C.sortOrder, C.id");
+        const QVector<QVariant> args = {game->id};
+        auto profiled = profile(sql, args);
+        auto query = exec(sql, args);
+        if (!query) return false;
+
+        SessionSnapshot::LastGame lastGame = {game->id, game->startTime, game->durationSeconds, {}};
+        int numRows = 0;
+        while (query->next()) {
+            numRows++;
+            auto courtId = query->value(0).value<CourtId>();
+            if (lastGame.courts.isEmpty() || lastGame.courts.last().courtId != courtId) {
+                lastGame.courts.append({courtId, query->value(1).toInt(), {}});
+            }
+            lastGame.courts.last().players.append(query->value(2).value<MemberId>());
+        }
+        profiled.setNumRows(numRows);
+        query->finish();
+
+        s.lastGame = std::move(lastGame);
+        return true;
+    }
+
+    void reloadLastGame(SessionId sessionId) {
+        if (auto cached = cachedSnapshot(sessionId); cached && !loadLastGame(*cached)) {
+            snapshot.reset();
+        }
+    }
+
+    bool removeGameAllocations(GameId gameId) {
+        return update(QStringLiteral("update member_pair_history set numGames = numGames - 1 where pairKey in (%1)")
+                              .arg(pairsOfGameSql), {gameId}) &&
+               update(QStringLiteral("delete from member_pair_history where numGames <= 0")) &&
+               update(QStringLiteral("delete from game_allocations where gameId = ?"), {gameId});
+    }
+
+    // Checking a member in again replaces their player row, which leaves the old row's allocations behind.
+    // Those are dropped here, along with one game for each time the member shared a court in them.
+    bool removePlayerAllocations(SessionId sessionId, MemberId memberId) {
+        return update(QStringLiteral("with S as (%1) "
+                                     "update member_pair_history "
+                                     "set numGames = numGames - (select count(*) from S where S.pairKey = member_pair_history.pairKey) "
+                                     "where pairKey in (select pairKey from S)").arg(pairsOfPlayerSql),
+                      {sessionId, memberId}) &&
+               update(QStringLiteral("delete from member_pair_history where numGames <= 0")) &&
+               update(QStringLiteral("delete from game_allocations "
+                                     "where playerId in (select id from players where sessionId = ? and memberId = ?)"),
+                      {sessionId, memberId});
+    }
 };
 
 ClubRepository::ClubRepository(QObject *parent, Impl *d)
-        : QObject(parent), d(d) {}
+        : QObject(parent), d(d) {
+    d->flushTimer.setSingleShot(true);
+    d->flushTimer.setInterval(0);
+    connect(&d->flushTimer, &QTimer::timeout, this, &ClubRepository::flushChanges);
+
+    auto recordSession = [=](SessionId sessionId) {
+        d->recordChange([=](ChangeSet &changes) { changes.sessions.insert(sessionId); });
+    };
+    auto recordPlayerFlag = [=](SessionId sessionId) {
+        d->recordChange([=](ChangeSet &changes) { changes.playerFlags.insert(sessionId); });
+    };
+    auto recordMember = [=](const BaseMember &member) {
+        d->recordChange([id = member.id](ChangeSet &changes) {
+            changes.members = true;
+            changes.memberIds.insert(id);
+        });
+    };
+    auto recordAllMembers = [=] {
+        d->recordChange([](ChangeSet &changes) {
+            changes.members = true;
+            changes.allMembers = true;
+        });
+    };
+
+    connect(this, &ClubRepository::sessionCreated, this, recordSession);
+    connect(this, &ClubRepository::playerCheckedIn, this, recordSession);
+    connect(this, &ClubRepository::playerCheckedOut, this, recordSession);
+    connect(this, &ClubRepository::gameCreated, this, recordSession);
+    connect(this, &ClubRepository::gameChanged, this, recordSession);
+    connect(this, &ClubRepository::gameWithdrawn, this, recordSession);
+    connect(this, &ClubRepository::paidChanged, this, recordPlayerFlag);
+    connect(this, &ClubRepository::pauseChanged, this, recordPlayerFlag);
+    connect(this, &ClubRepository::memberCreated, this, recordMember);
+    connect(this, &ClubRepository::memberUpdated, this, recordMember);
+    connect(this, &ClubRepository::membersImported, this, recordAllMembers);
+    connect(this, &ClubRepository::clubInfoChanged, this, [=] {
+        d->recordChange([](ChangeSet &changes) { changes.clubInfo = true; });
+    });
+}
 
 ClubRepository::~ClubRepository() {
+    if (d->readPool) {
+        // The database thread outlives us, so its reader is closed there
+        d->readPool->waitForDone();
+        QtConcurrent::run(d->readPool.get(), [this] {
+            d->threadReaders->close(QThread::currentThread());
+        }).waitForFinished();
+    }
+
+    // Readers of other threads still running are closed as those threads finish
+
+    if (d->changeStats.numChanges > 0) {
+        qDebug() << "Coalesced" << d->changeStats.numChanges << "changes into" << d->changeStats.numFlushes
+                 << "notifications," << d->changeStats.numAvoided() << "reloads avoided";
+    }
+    d->statements.clear();
     d->db.close();
+
+    const auto connectionName = d->db.connectionName();
     delete d;
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+static bool applyProfile(QSqlDatabase &db, const DatabaseProfile &profile) {
+    // Journal mode can't be changed inside a transaction, so these go before any migration.
+    // A WAL database lets readers on other connections carry on while a write is in progress.
+    const QString pragmas[] = {
+            QStringLiteral("pragma journal_mode = %1").arg(profile.journalMode),
+            QStringLiteral("pragma synchronous = %1").arg(profile.synchronous),
+            QStringLiteral("pragma mmap_size = %1").arg(profile.mmapSize),
+            QStringLiteral("pragma cache_size = %1").arg(-profile.cacheSizeKiB),
+            QStringLiteral("pragma temp_store = %1").arg(
+                    profile.tempStoreInMemory ? QStringLiteral("memory") : QStringLiteral("default")),
+            QStringLiteral("pragma busy_timeout = %1").arg(profile.busyTimeoutMs),
+    };
+
+    QSqlQuery q(db);
+    for (const auto &pragma : pragmas) {
+        if (!q.exec(pragma)) {
+            qCritical() << "Error executing " << pragma << ":" << q.lastError();
+            return false;
+        }
+    }
+
+    if (q.exec(QStringLiteral("pragma journal_mode")) && q.next() &&
+        q.value(0).toString().compare(profile.journalMode, Qt::CaseInsensitive) != 0) {
+        // In-memory databases can only use the memory journal
+        qDebug() << "Using journal mode" << q.value(0).toString() << "instead of" << profile.journalMode;
+    }
+
+    return true;
+}
+
+// Runs the `---` separated statements of an SQL resource
+static bool execSqlFile(QSqlDatabase &db, const QString &fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Unable to open file: " << fileName;
+        return false;
+    }
+
+    QSqlQuery q(db);
+    for (auto sql : QString::fromUtf8(file.readAll()).split(QStringLiteral("---"))) {
+        sql = sql.trimmed();
+        if (sql.isEmpty()) continue;
+        if (!q.exec(sql)) {
+            qCritical() << "Error executing sql " << sql << ":" << q.lastError();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Archived sessions live in a file next to the club's, a club in memory keeps them in memory too
+static QString archivePathOf(const QString &path) {
+    if (path.isEmpty() || path == QStringLiteral(":memory:")) return QStringLiteral(":memory:");
+    return path + QStringLiteral(".archive");
+}
+
+// The archive file is only made once the club is set to archive sessions, a club in memory always has one
+static bool wantsArchive(QSqlDatabase &db, const QString &archivePath) {
+    if (archivePath == QStringLiteral(":memory:") || QFile::exists(archivePath)) return true;
+
+    // A new club has no settings table yet
+    QSqlQuery q(db);
+    q.prepare(QStringLiteral("select cast(value as integer) from settings where name = ?"));
+    q.addBindValue(skArchiveAfterMonths);
+    return q.exec() && q.next() && q.value(0).toInt() > 0;
+}
+
+// Attaches the archive and puts the all_* views over it and the club's own tables, for this connection only.
+// Attaching can't be done inside a transaction.
+//
+// In WAL mode a transaction over both files isn't atomic: each file commits on its own, so a crash can leave
+// one side committed and not the other. archiveSessions() therefore commits the copy before it takes anything
+// out of the club, and open finishes off any session found in both files.
+static bool attachArchive(QSqlDatabase &db, const QString &archivePath, bool createTables) {
+    QSqlQuery q(db);
+    q.prepare(QStringLiteral("attach database ? as archive"));
+    q.addBindValue(archivePath);
+    if (!q.exec()) {
+        qWarning() << "Unable to attach archive" << archivePath << ":" << q.lastError();
+        return false;
+    }
+
+    return (!createTables || execSqlFile(db, QStringLiteral(":/sql/archive.sql"))) &&
+           execSqlFile(db, QStringLiteral(":/sql/archive_views.sql"));
+}
+
+// fts5() hands out the extension's API and is there whenever FTS5 is, built in or loaded
+static bool hasFts5(QSqlDatabase &db) {
+    QSqlQuery q(db);
+    return q.exec(QStringLiteral("select fts5(null)"));
+}
+
+static bool hasMemberSearchTable(QSqlDatabase &db) {
+    return DbUtils::queryFirst<int>(
+            db,
+            QStringLiteral("select count(*) from sqlite_master where type = 'table' and name = 'member_search'"))
+                   .orDefault(0) > 0;
+}
+
+static void dropMemberSearch(QSqlDatabase &db) {
+    QSqlQuery q(db);
+    q.exec(QStringLiteral("drop trigger if exists member_search_insert"));
+    q.exec(QStringLiteral("drop trigger if exists member_search_delete"));
+    q.exec(QStringLiteral("drop trigger if exists member_search_update"));
+
+    // Fails without FTS5, but a table no trigger writes to is harmless
+    if (!q.exec(QStringLiteral("drop table if exists member_search"))) {
+        qWarning() << "Unable to drop the member search index:" << q.lastError();
+    }
 }
 
-ClubRepository *ClubRepository::open(QObject *parent, const QString &path) {
-    std::unique_ptr<Impl> d(new Impl);
+// The full text index lives outside the schema files as not every SQLite build comes with FTS5.
+// Without it member search falls back to LIKE.
+static bool setUpMemberSearch(QSqlDatabase &db) {
+    if (!hasFts5(db)) {
+        // The index may have been made by a build with FTS5, whose triggers would now fail every write to members
+        qWarning() << "FTS5 is not available, member search falls back to LIKE";
+        dropMemberSearch(db);
+        return false;
+    }
+
+    if (hasMemberSearchTable(db)) {
+        return true;
+    }
+
+    const QString sqls[] = {
+            QStringLiteral("create virtual table member_search using fts5("
+                           "firstName, lastName, phone, email, "
+                           "content = 'members', content_rowid = 'id', tokenize = 'unicode61 remove_diacritics 2')"),
+            QStringLiteral("create trigger member_search_insert after insert on members begin "
+                           "insert into member_search (rowid, firstName, lastName, phone, email) "
+                           "values (new.id, new.firstName, new.lastName, new.phone, new.email); "
+                           "end"),
+            QStringLiteral("create trigger member_search_delete after delete on members begin "
+                           "insert into member_search (member_search, rowid, firstName, lastName, phone, email) "
+                           "values ('delete', old.id, old.firstName, old.lastName, old.phone, old.email); "
+                           "end"),
+            QStringLiteral("create trigger member_search_update after update on members begin "
+                           "insert into member_search (member_search, rowid, firstName, lastName, phone, email) "
+                           "values ('delete', old.id, old.firstName, old.lastName, old.phone, old.email); "
+                           "insert into member_search (rowid, firstName, lastName, phone, email) "
+                           "values (new.id, new.firstName, new.lastName, new.phone, new.email); "
+                           "end"),
+            QStringLiteral("insert into member_search (member_search) values ('rebuild')"),
+    };
+
+    QSqlQuery q(db);
+    for (const auto &sql : sqls) {
+        if (!q.exec(sql)) {
+            qWarning() << "Member search index unavailable:" << q.lastError();
+
+            // Don't leave triggers behind that would fail every write to members
+            dropMemberSearch(db);
+            return false;
+        }
+    }
+    return true;
+}
+
+ClubRepository *ClubRepository::open(QObject *parent, const QString &path, const DatabaseProfile &profile) {
+    std::unique_ptr<Impl> d(new Impl(newConnectionName(QStringLiteral("club"))));
     d->db.setDatabaseName(path);
     if (!d->db.open() || !d->db.isValid()) {
         qCritical().noquote() << "Error opening: " << path << " : " << d->db.lastError();
         return nullptr;
     }
 
+    if (!applyProfile(d->db, profile)) {
+        return nullptr;
+    }
+
+    // Reports read through the all_* views, which cover the club alone when there's no archive
+    if (const auto archivePath = archivePathOf(path); wantsArchive(d->db, archivePath)) {
+        d->archiveAvailable = attachArchive(d->db, archivePath, true);
+        if (!d->archiveAvailable) QSqlQuery(d->db).exec(QStringLiteral("detach database archive"));
+    }
+    if (!d->archiveAvailable && !execSqlFile(d->db, QStringLiteral(":/sql/main_views.sql"))) return nullptr;
+
     int currSchemaVersion = 0;
 
     SQLTransaction tx(d->db);
@@ -120,12 +865,109 @@ ClubRepository *ClubRepository::open(QObject *parent, const QString &path) {
         return nullptr;
     }
 
+    d->memberSearchAvailable = setUpMemberSearch(d->db);
+    d->loadSettings();
+
+    // Sessions in both files are from an archive that stopped after the archive's side went in
+    if (d->archiveAvailable && d->selectArchivingSessions(QStringLiteral("select id from archive.sessions where id in (select id from main.sessions)"), {})
+                .value_or(0) > 0 && !d->deleteArchived()) {
+        tx.setError();
+        return nullptr;
+    }
+
+    if (!path.isEmpty() && path != QStringLiteral(":memory:")) {
+        d->readPool = std::make_unique<QThreadPool>();
+        d->readPool->setMaxThreadCount(1);
+        d->readPool->setExpiryTimeout(-1);
+        d->path = path;
+        d->sharedDatabase = true;
+    }
+
     return new ClubRepository(parent, d.release());
 }
 
+ClubRepository *ClubRepository::openReader(const QString &path) {
+    std::unique_ptr<Impl> d(new Impl(newConnectionName(QStringLiteral("club_reader"))));
+    d->db.setDatabaseName(path);
+    d->db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000"));
+    if (!d->db.open()) {
+        qCritical().noquote() << "Error opening reader for: " << path << " : " << d->db.lastError();
+        return nullptr;
+    }
+
+    // A read only connection can't make the archive, the main repository does that when it's wanted
+    const auto archivePath = archivePathOf(path);
+    d->archiveAvailable = QFile::exists(archivePath) && attachArchive(d->db, archivePath, false);
+    if (!d->archiveAvailable) {
+        QSqlQuery(d->db).exec(QStringLiteral("detach database archive"));
+        if (!execSqlFile(d->db, QStringLiteral(":/sql/main_views.sql"))) {
+            qWarning() << "Reports on this connection won't work";
+        }
+    }
+
+    // Writes go through the main repository, which this one would never hear about
+    d->snapshotEnabled = false;
+    d->sharedDatabase = true;
+    d->memberSearchAvailable = hasFts5(d->db) && hasMemberSearchTable(d->db);
+    return new ClubRepository(nullptr, d.release());
+}
+
+ClubRepository *ClubRepository::openWriter(const QString &path) {
+    std::unique_ptr<Impl> d(new Impl(newConnectionName(QStringLiteral("club_writer"))));
+    d->db.setDatabaseName(path);
+    d->db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=5000"));
+    if (!d->db.open()) {
+        qCritical().noquote() << "Error opening writer for: " << path << " : " << d->db.lastError();
+        return nullptr;
+    }
+
+    const auto archivePath = archivePathOf(path);
+    d->archiveAvailable = QFile::exists(archivePath) && attachArchive(d->db, archivePath, false);
+    if (!d->archiveAvailable) {
+        QSqlQuery(d->db).exec(QStringLiteral("detach database archive"));
+        if (!execSqlFile(d->db, QStringLiteral(":/sql/main_views.sql"))) return nullptr;
+    }
+
+    // The main repository drops its own caches once the work is done
+    d->snapshotEnabled = false;
+    return new ClubRepository(nullptr, d.release());
+}
+
+QThreadPool *ClubRepository::readThread() const {
+    return d->readPool.get();
+}
+
+bool ClubRepository::canReadOnAnyThread() const {
+    return !d->path.isEmpty();
+}
+
+const ClubRepository *ClubRepository::readerForCurrentThread() const {
+    auto thread = QThread::currentThread();
+    if (thread == this->thread()) return this;
+    if (d->path.isEmpty()) return nullptr;
+
+    auto threadReaders = d->threadReaders;
+    QMutexLocker locker(&threadReaders->lock);
+    if (auto found = threadReaders->readers.constFind(thread); found != threadReaders->readers.constEnd()) {
+        return found->repository;
+    }
+
+    auto reader = openReader(d->path);
+    if (!reader) return nullptr;
+
+    // Pool threads come and go, the connection goes with the thread that made it. Finished is emitted on
+    // the thread itself, so the direct connection closes it there.
+    auto threadFinished = connect(thread, &QThread::finished, thread, [threadReaders, thread] {
+        threadReaders->close(thread);
+    }, Qt::DirectConnection);
+
+    threadReaders->readers.insert(thread, {reader, threadFinished});
+    return reader;
+}
+
 std::optional<SessionId> ClubRepository::getLastSession() const {
-    return DbUtils::queryFirst<SessionId>(d->db, QStringLiteral(
-            "select id from sessions order by startTime desc, id desc limit 1")).toOptional();
+    return d->queryFirst<SessionId>(QStringLiteral(
+            "select id from sessions order by startTime desc, id desc limit 1"));
 }
 
 std::optional<SessionData>
@@ -135,8 +977,7 @@ ClubRepository::createSession(unsigned fee, const QString &place, const QString
     if (courts.isEmpty() || numPlayersPerCourt == 0) return std::nullopt;
 
     SQLTransaction trans(d->db);
-    auto sessionId = DbUtils::insert<SessionId>(
-            d->db,
+    auto sessionId = d->insert<SessionId>(
             QStringLiteral("insert into sessions (fee, place, announcement, numPlayersPerCourt) values (?, ?, ?, ?)"),
             {fee, place, announcement, numPlayersPerCourt});
     if (!sessionId) {
@@ -145,8 +986,7 @@ ClubRepository::createSession(unsigned fee, const QString &place, const QString
     }
 
     for (const auto &court : courts) {
-        auto courtResult = DbUtils::update(
-                d->db,
+        auto courtResult = d->update(
                 QStringLiteral(
                         "insert into courts (sessionId, name, sortOrder) values (?, ?, ?)"),
                 {*sessionId, court.name, court.sortOrder});
@@ -159,6 +999,7 @@ ClubRepository::createSession(unsigned fee, const QString &place, const QString
 
     if (auto data = getSession(*sessionId)) {
         emit this->sessionChanged(*sessionId);
+        emit sessionCreated(*sessionId);
         return data;
     }
 
@@ -167,69 +1008,113 @@ ClubRepository::createSession(unsigned fee, const QString &place, const QString
 }
 
 QVector<GameAllocation> ClubRepository::getPastAllocations(SessionId id) const {
-    return DbUtils::queryList<GameAllocation>(
-            d->db,
-            QStringLiteral("select GA.gameId, GA.courtId, P.memberId, GA.quality from game_allocations GA "
-                           "inner join players P on P.id = GA.playerId "
-                           "where GA.gameId in ( "
-                           "select id from games where sessionId = ?)"),
-            {id}).orDefault();
+    return getAllocationsSince(id, std::nullopt);
 }
 
-MemberGameStats ClubRepository::getMemberGameStats(MemberId memberId, SessionId sessionId) const {
-    QVector<MemberGameStats::PastGame> pastGames;
-    size_t numGames = 0;
-
-
-    DbUtils::queryRawStream(
-            d->db, QStringLiteral(
-                    "select G.id as gameId, C.id as courtId, C.name as courtName, cast(strftime('%s', G.startTime) as integer) as startTime, GA.quality, M.* from game_allocations GA "
-                    "inner join games G on G.id = GA.gameId "
-                    "inner join players P on P.id = GA.playerId "
-                    "inner join courts C on C.id = GA.courtId "
-                    "inner join normalized_members M on M.id = P.memberId "
-                    "where P.sessionId = ? "
-                    "order by G.startTime desc, G.id, C.id, M.firstName, M.lastName"),
-            {sessionId},
-            [&](const QSqlRecord &record) -> bool {
-                auto gameId = record.value(QStringLiteral("gameId")).value<GameId>();
-                auto courtId = record.value(QStringLiteral("courtId")).value<GameId>();
-
-                if (numGames == 0 || pastGames.last().gameId != gameId) {
-                    numGames++;
-                }
-
-                if (pastGames.isEmpty() ||
-                    (pastGames.last().gameId != gameId || pastGames.last().courtId != courtId)) {
-                    pastGames.push_back({
-                                                gameId, courtId, record.value(QStringLiteral("courtName")).toString(),
-                                                QDateTime::fromSecsSinceEpoch(
-                                                        record.value(QStringLiteral("startTime")).toLongLong()),
-                                                record.value(QStringLiteral("quality")).toInt()
-                                        });
-                }
+QVector<GameAllocation> ClubRepository::getAllocationsSince(SessionId id, std::optional<GameId> afterGameId) const {
+    return d->queryList<GameAllocation>(
+            QStringLiteral("select GA.gameId, GA.courtId, P.memberId, GA.quality from games G "
+                           "inner join game_allocations GA on GA.gameId = G.id "
+                           "inner join players P on P.id = GA.playerId "
+                           "where G.sessionId = ? and G.id > ? "
+                           "order by G.id"),
+            {id, afterGameId.value_or(0)}).value_or(QVector<GameAllocation>());
+}
 
-                auto &pastGame = pastGames.last();
-                pastGame.players.push_back(BaseMember());
-                if (!DbUtils::readFrom(pastGame.players.last(), record)) {
-                    qWarning() << "Unable to read member for stats";
-                }
+int ClubRepository::getNumGames(SessionId id) const {
+    return d->queryFirst<int>(QStringLiteral("select count(*) from games where sessionId = ?"), {id}).value_or(0);
+}
 
-                return true;
-            });
+QHash<MemberId, PlayerCounters> ClubRepository::getPlayerCounters(SessionId sessionId) const {
+    QHash<MemberId, PlayerCounters> counters;
+    static const auto sql = QStringLiteral(
+            "select P.memberId, P.gamesPlayed, P.lastGameId, cast(strftime('%s', P.lastPlayedAt) as integer), "
+            "(select count(*) from games G where G.sessionId = P.sessionId and G.id > coalesce(P.lastGameId, 0)) "
+            "from players P where P.sessionId = ?");
+    const QVector<QVariant> args = {sessionId};
+    auto profiled = d->profile(sql, args);
+    auto query = d->exec(sql, args);
+    if (!query) return counters;
+
+    while (query->next()) {
+        PlayerCounters c;
+        c.gamesPlayed = query->value(1).toInt();
+        if (!query->value(2).isNull()) c.lastGameId = query->value(2).value<GameId>();
+        c.lastPlayedAt = query->value(3).toLongLong();
+        c.numGamesOff = query->value(4).toInt();
+        counters.insert(query->value(0).value<MemberId>(), c);
+    }
+    profiled.setNumRows(counters.size());
+    query->finish();
+    return counters;
+}
 
-    MemberGameStats gameStats = {numGames};
+MemberGameStats ClubRepository::getMemberGameStats(MemberId memberId, SessionId sessionId) const {
+    const auto key = qMakePair(sessionId, memberId);
+    if (auto found = d->gameStats.constFind(key); found != d->gameStats.constEnd()) {
+        if (!d->sharedDatabase || d->dataVersion() == d->gameStatsDataVersion) return *found;
+        d->gameStats.clear();
+    }
 
-    for (const auto &game : pastGames) {
-        for (const auto &player : game.players) {
-            if (player.id == memberId) {
-                gameStats.numGamesOff--;
-                gameStats.pastGames.append(game);
-                break;
+    // Taken before reading, so a write landing in between drops what's read too
+    if (d->sharedDatabase && d->gameStats.isEmpty()) d->gameStatsDataVersion = d->dataVersion();
+
+    // Only the games the member played, with everyone who was on the court with them
+    static const auto sql = QStringLiteral(
+            "select G.id, C.id, C.name, cast(strftime('%s', G.startTime) as integer), GA.quality, "
+            "M.id, M.registerDate, M.firstName, M.lastName, M.gender = 'female', M.level, M.email, M.phone "
+            "from players Me "
+            "inner join game_allocations MyGA on MyGA.playerId = Me.id "
+            "inner join games G on G.id = MyGA.gameId "
+            "inner join courts C on C.id = MyGA.courtId "
+            "inner join game_allocations GA on GA.gameId = MyGA.gameId and GA.courtId = MyGA.courtId "
+            "inner join players P on P.id = GA.playerId "
+            "inner join normalized_members M on M.id = P.memberId "
+            "where Me.sessionId = ? and Me.memberId = ? "
+            "order by G.startTime desc, G.id, C.id, M.firstName, M.lastName");
+
+    MemberGameStats gameStats;
+    {
+        const QVector<QVariant> args = {sessionId, memberId};
+        auto profiled = d->profile(sql, args);
+        auto query = d->exec(sql, args);
+        if (!query) return gameStats;
+
+        int numRows = 0;
+        while (query->next()) {
+            numRows++;
+            const auto gameId = query->value(0).value<GameId>();
+            const auto courtId = query->value(1).value<CourtId>();
+            if (gameStats.pastGames.isEmpty() ||
+                gameStats.pastGames.last().gameId != gameId || gameStats.pastGames.last().courtId != courtId) {
+                gameStats.pastGames.push_back({
+                        gameId, courtId, query->value(2).toString(),
+                        QDateTime::fromSecsSinceEpoch(query->value(3).toLongLong()),
+                        query->value(4).toInt()
+                });
             }
+
+            BaseMember player;
+            player.id = query->value(5).value<MemberId>();
+            player.registerDate = query->value(6).toLongLong();
+            player.firstName = query->value(7).toString();
+            player.lastName = query->value(8).toString();
+            player.gender = query->value(9).toBool() ? BaseMember::Female : BaseMember::Male;
+            player.level = query->value(10).toInt();
+            player.email = query->value(11).toString();
+            player.phone = query->value(12).toString();
+            gameStats.pastGames.last().players.push_back(player);
         }
+        profiled.setNumRows(numRows);
+        query->finish();
     }
 
+    gameStats.numGamesOff = d->queryFirst<int>(
+            QStringLiteral("select max(0, (select count(*) from games where sessionId = ?) - gamesPlayed) "
+                           "from players where sessionId = ? and memberId = ?"),
+            {sessionId, sessionId, memberId}).value_or(0);
+
+    d->gameStats.insert(key, gameStats);
     return gameStats;
 }
 
@@ -241,8 +1126,7 @@ std::optional<GameId> ClubRepository::createGame(SessionId sessionId,
 
     SQLTransaction tx(d->db);
 
-    auto gameId = DbUtils::insert<GameId>(
-            d->db,
+    auto gameId = d->insert<GameId>(
             QStringLiteral("insert into games (sessionId, durationSeconds) values (?, ?)"),
             {sessionId, durationSeconds});
 
@@ -251,24 +1135,81 @@ std::optional<GameId> ClubRepository::createGame(SessionId sessionId,
         return std::nullopt;
     }
 
-    for (const auto &ga : allocations) {
-        auto insertResult = DbUtils::update(
-                d->db,
-                QStringLiteral("insert into game_allocations (gameId, courtId, playerId, quality) values (?, ?, "
-                               "(select P.id from players P where P.memberId = ? and P.sessionId = ?), "
-                               "?)"),
-                {*gameId, ga.courtId, ga.memberId, sessionId, ga.quality});
-
-        if (!insertResult) {
-            tx.setError();
-            return std::nullopt;
-        }
+    if (!d->insertGameAllocations(sessionId, *gameId, allocations)) {
+        tx.setError();
+        return std::nullopt;
     }
 
+    d->reloadLastGame(sessionId);
+    d->forgetGameStats(sessionId);
     emit this->sessionChanged(sessionId);
+    emit gameCreated(sessionId, *gameId);
     return *gameId;
 }
 
+bool ClubRepository::replaceGameAllocations(SessionId sessionId, GameId gameId,
+                                            const QVector<GameAllocation> &allocations) {
+    if (allocations.empty()) return false;
+
+    SQLTransaction tx(d->db);
+
+    if (d->queryFirst<int>(
+            QStringLiteral("select count(*) from games where id = ? and sessionId = ?"),
+            {gameId, sessionId}).value_or(0) == 0) {
+        return false;
+    }
+
+    if (!d->removeGameAllocations(gameId) ||
+        !d->insertGameAllocations(sessionId, gameId, allocations)) {
+        tx.setError();
+        return false;
+    }
+
+    d->reloadLastGame(sessionId);
+    d->forgetGameStats(sessionId);
+    emit this->sessionChanged(sessionId);
+    emit gameChanged(sessionId, gameId);
+    return true;
+}
+
+CoPlayHistory ClubRepository::getCoPlayHistory(std::optional<SessionId> excludedSession) const {
+    CoPlayHistory history;
+    const auto now = QDateTime::currentSecsSinceEpoch();
+
+    static const auto allSql = QStringLiteral(
+            "select pairKey, numGames, cast(strftime('%s', lastPlayed) as integer) as lastPlayed "
+            "from member_pair_history order by pairKey");
+
+    // The history keeps one total per pair, so the session's own games are taken off it. A pair that
+    // played in the session still ages from then, which only errs towards keeping them apart.
+    static const auto excludingSql = QStringLiteral(
+            "select H.pairKey, H.numGames - coalesce(S.numGames, 0) as numGames, "
+            "cast(strftime('%s', H.lastPlayed) as integer) as lastPlayed "
+            "from member_pair_history H "
+            "left join (select pairKey, count(*) as numGames from (%1) group by pairKey) S on S.pairKey = H.pairKey "
+            "order by H.pairKey").arg(pairsOfSessionSql);
+
+    const auto &sql = excludedSession ? excludingSql : allSql;
+    QVector<QVariant> args;
+    if (excludedSession) args.push_back(*excludedSession);
+
+    auto profiled = d->profile(sql, args);
+    auto query = d->exec(sql, args);
+    if (!query) return history;
+
+    int numRows = 0;
+    while (query->next()) {
+        numRows++;
+        const auto ageDays = std::max<qlonglong>(0, now - query->value(2).toLongLong()) / 86400.0;
+        history.insert(query->value(0).value<CoPlayHistory::PairKey>(),
+                       query->value(1).toDouble() * std::pow(0.5, ageDays / coPlayHalfLifeDays));
+    }
+    profiled.setNumRows(numRows);
+    query->finish();
+
+    return history;
+}
+
 static void sanitizeMemberNames(QString &firstName, QString &lastName) {
     firstName = firstName.trimmed();
     lastName = lastName.trimmed();
@@ -286,8 +1227,7 @@ ClubRepository::createMember(QString firstName,
 
     SQLTransaction tx(d->db);
 
-    auto memberId = DbUtils::insert<MemberId>(
-            d->db,
+    auto memberId = d->insert<MemberId>(
             QStringLiteral(
                     "insert into members (firstName, lastName, gender, level, registerDate, phone, email) values (?, ?, ?, ?, ?, ?, ?)"),
             {firstName, lastName, enumToString(gender).toLower(), level, QDateTime::currentSecsSinceEpoch(),
@@ -299,43 +1239,44 @@ ClubRepository::createMember(QString firstName,
         return std::nullopt;
     }
 
+    auto member = getMember(*memberId);
     emit memberChanged();
+    if (member) emit memberCreated(*member);
 
-    return getMember(*memberId);
+    return member;
 }
 
 static std::pair<QString, QVector<QVariant>> constructFindMembersSql(const MemberSearchFilter &filter,
                                                                      const QString &extraWhere = QString(),
-                                                                     const QVector<QVariant> &extraWhereArgs = {}) {
+                                                                     const QVector<QVariant> &extraWhereArgs = {},
+                                                                     const QString &orderBy = QStringLiteral(
+                                                                             "firstName, lastName")) {
+    const auto where = orderBy.isEmpty() ? extraWhere : QStringLiteral("%1 order by %2").arg(extraWhere, orderBy);
+
     QString sql;
     QVector<QVariant> args;
     if (std::get_if<AllMembers>(&filter)) {
-        sql += QStringLiteral("select * from normalized_members where 1 %1 order by firstName, lastName").arg(
-                extraWhere);
+        sql += QStringLiteral("select * from normalized_members where 1 %1").arg(where);
     } else if (auto checkedIn = std::get_if<CheckedIn>(&filter)) {
         if (checkedIn->paused == true) {
-            sql += QStringLiteral(
-                    "select * from paused_members where sessionId = ? %1 order by firstName, lastName").arg(extraWhere);
+            sql += QStringLiteral("select * from paused_members where sessionId = ? %1").arg(where);
         } else if (checkedIn->paused == false) {
-            sql += QStringLiteral(
-                    "select * from checked_in_non_paused_members where sessionId = ? %1 order by firstName, lastName").arg(
-                    extraWhere);
+            sql += QStringLiteral("select * from checked_in_non_paused_members where sessionId = ? %1").arg(where);
         } else {
-            sql += QStringLiteral(
-                    "select * from session_members where status != ? and sessionId = ? %1 order by firstName, lastName").arg(
-                    extraWhere);
+            sql += QStringLiteral("select * from session_members where status != ? and sessionId = ? %1").arg(where);
             args.push_back(enumToString(Member::CheckedOut));
         }
 
         args += checkedIn->sessionId;
     } else if (auto nonCheckedIn = std::get_if<NonCheckedIn>(&filter)) {
+        // Straight from members rather than the view, so the session is looked up once instead of joined
         sql += QStringLiteral(
-                "select * from unchecked_in_members where sessionId = ? %1 order by firstName, lastName").arg(
-                extraWhere);
+                "select M.*, false as paid, 'NotCheckedIn' as status from normalized_members M "
+                "where not exists (select 1 from players P where P.sessionId = ? and P.memberId = M.id) %1").arg(
+                where);
         args += nonCheckedIn->sessionId;
     } else if (auto allSession = std::get_if<AllSession>(&filter)) {
-        sql += QStringLiteral("select * from session_members where sessionId = ? %1 order by firstName, lastName").arg(
-                extraWhere);
+        sql += QStringLiteral("select * from session_members where sessionId = ? %1").arg(where);
         args += allSession->sessionId;
     }
 
@@ -344,55 +1285,115 @@ static std::pair<QString, QVector<QVariant>> constructFindMembersSql(const Membe
     return std::make_pair(sql, args);
 }
 
+// The session a filter can be served from the snapshot for
+static std::optional<SessionId> sessionOfFilter(const MemberSearchFilter &filter) {
+    if (auto allSession = std::get_if<AllSession>(&filter)) return allSession->sessionId;
+    if (auto checkedIn = std::get_if<CheckedIn>(&filter)) return checkedIn->sessionId;
+    return std::nullopt;
+}
+
+// Every word of the needle as a prefix, e.g. 'jo sm' becomes '"jo"* "sm"*'
+static QString memberSearchQuery(const QString &needle) {
+    QStringList terms;
+    for (auto term : needle.simplified().split(QLatin1Char(' '), Qt::SkipEmptyParts)) {
+        term.remove(QLatin1Char('"'));
+        if (!term.isEmpty()) terms.append(QStringLiteral("\"%1\"*").arg(term));
+    }
+    return terms.join(QLatin1Char(' '));
+}
+
 QVector<Member> ClubRepository::findMember(MemberSearchFilter filter, const QString &needle) const {
+    auto trimmed = needle.trimmed();
+
+    if (auto query = memberSearchQuery(trimmed); d->memberSearchAvailable && !query.isEmpty()) {
+        auto[filterSql, args] = constructFindMembersSql(filter, QString(), {}, QString());
+        args += query;
+        return d->queryList<Member>(
+                QStringLiteral("select F.* from (%1) F "
+                               "inner join member_search on member_search.rowid = F.id "
+                               "where member_search match ? "
+                               "order by rank, F.firstName, F.lastName").arg(filterSql),
+                args).value_or(QVector<Member>());
+    }
+
+    // Same as the full text search, every word has to start one of the fields
     QString extraWhere;
     QVector<QVariant> extraWhereArgs;
-
-    auto trimmed = needle.trimmed();
-    if (!trimmed.isEmpty()) {
-        extraWhere = QStringLiteral(" and (firstName like ?)");
-        extraWhereArgs += QStringLiteral("%1%%").arg(trimmed);
+    for (const auto &term : trimmed.simplified().split(QLatin1Char(' '), Qt::SkipEmptyParts)) {
+        extraWhere += QStringLiteral(" and (firstName like ? or lastName like ? or phone like ? or email like ?)");
+        extraWhereArgs += QVector<QVariant>(4, QStringLiteral("%1%%").arg(term));
     }
 
     auto[sql, args] = constructFindMembersSql(filter, extraWhere, extraWhereArgs);
-    return DbUtils::queryList<Member>(d->db, sql, args).orDefault();
+    return d->queryList<Member>(sql, args).value_or(QVector<Member>());
+}
+
+QStringList ClubRepository::getMembersQueryPlan(MemberSearchFilter filter) const {
+    auto[sql, args] = constructFindMembersSql(filter);
+    return d->explainQueryPlan(sql, args);
 }
 
 QVector<Member> ClubRepository::getMembers(MemberSearchFilter filter) const {
+    if (auto sessionId = sessionOfFilter(filter)) {
+        if (auto snapshot = d->snapshotOf(*sessionId)) return snapshot->membersFor(filter);
+    }
+
     auto[sql, args] = constructFindMembersSql(filter);
-    auto members = DbUtils::queryList<Member>(d->db, sql, args).orDefault();
+    auto members = d->queryList<Member>(sql, args).value_or(QVector<Member>());
     formatMemberDisplayNames(members);
     return members;
 }
 
 bool ClubRepository::checkIn(SessionId sessionId, MemberId memberId, bool paid) {
-    auto rc = DbUtils::update(
-            d->db,
-            QStringLiteral(
-                    "insert or replace into players (sessionId, memberId, paid, checkInTime, checkOutTime) values (?, ?, ?, current_timestamp, null)"),
-            {sessionId, memberId, paid}).orDefault(0) > 0;
-    if (rc) {
+    SQLTransaction tx(d->db);
+    auto rc = d->removePlayerAllocations(sessionId, memberId) &&
+              d->update(QStringLiteral(
+                      "insert or replace into players (sessionId, memberId, paid, checkInTime, checkOutTime) values (?, ?, ?, current_timestamp, null)"),
+                        {sessionId, memberId, paid}).value_or(0) > 0;
+    if (!rc) {
+        tx.setError();
+    } else {
+        auto member = d->queryFirst<Member>(
+                QStringLiteral("select * from session_members where sessionId = ? and id = ?"),
+                {sessionId, memberId});
+
+        if (auto snapshot = d->cachedSnapshot(sessionId)) {
+            // Checking in again replaces the player, which takes their past allocations with it
+            if (member && !snapshot->findMember(memberId)) {
+                snapshot->upsertMember(*member);
+            } else {
+                d->snapshot.reset();
+            }
+        }
+        d->forgetGameStats(sessionId);
+
         emit this->sessionChanged(sessionId);
         emit memberChanged();
+        if (member) emit playerCheckedIn(sessionId, *member);
     }
     return rc;
 }
 
 bool ClubRepository::checkOut(SessionId sessionId, MemberId memberId) {
-    auto rc = DbUtils::update(
-            d->db,
+    auto rc = d->update(
             QStringLiteral("update players set checkOutTime = current_timestamp where sessionId = ? and memberId = ?"),
-            {sessionId, memberId}).orDefault(0) > 0;
+            {sessionId, memberId}).value_or(0) > 0;
     if (rc) {
+        if (auto snapshot = d->cachedSnapshot(sessionId)) {
+            if (auto member = snapshot->findMember(memberId)) member->status = Member::CheckedOut;
+        }
+
         emit this->sessionChanged(sessionId);
         emit memberChanged();
+        emit playerCheckedOut(sessionId, memberId);
     }
     return rc;
 }
 
 std::optional<GameInfo> ClubRepository::getLastGameInfo(SessionId sessionId) const {
-    auto gameResult = DbUtils::queryFirst<GameInfo>(
-            d->db,
+    if (auto snapshot = d->snapshotOf(sessionId)) return snapshot->lastGameInfo();
+
+    auto gameResult = d->queryFirst<GameInfo>(
             QStringLiteral(
                     "select id, cast(strftime('%s',startTime) as integer) as startTime, durationSeconds from games "
                     "where sessionId = ? "
@@ -401,8 +1402,7 @@ std::optional<GameInfo> ClubRepository::getLastGameInfo(SessionId sessionId) con
 
     if (!gameResult) return std::nullopt;
 
-    auto onMembers = DbUtils::queryList<GameAllocationMember>(
-            d->db,
+    auto onMembers = d->queryList<GameAllocationMember>(
             QStringLiteral("select M.*, "
                            "C.id as courtId, C.name as courtName, GA.quality as courtQuality from game_allocations GA "
                            "inner join games G on G.id = GA.gameId "
@@ -441,23 +1441,61 @@ std::optional<GameInfo> ClubRepository::getLastGameInfo(SessionId sessionId) con
 }
 
 std::optional<QString> ClubRepository::getSetting(const SettingKey &key) const {
-    return DbUtils::queryFirst<QString>(
-            d->db, QStringLiteral("select value from settings where name = ?"), {key})
-            .toOptional();
+    if (d->settings) {
+        if (auto found = d->settings->values.constFind(key); found != d->settings->values.constEnd()) {
+            return *found;
+        }
+        return std::nullopt;
+    }
+
+    return d->queryFirst<QString>(QStringLiteral("select value from settings where name = ?"), {key});
+}
+
+std::optional<QVariant> ClubRepository::getSettingVariant(const SettingKey &key, int typeId) const {
+    auto convert = [&]() -> std::optional<QVariant> {
+        auto stringValue = getSetting(key);
+        if (!stringValue) return std::nullopt;
+
+        QVariant variant = *stringValue;
+        if (variant.convert(typeId)) return variant;
+        return std::nullopt;
+    };
+
+    if (!d->settings) return convert();
+
+    auto &typed = d->settings->typedValues[key];
+    if (auto found = typed.constFind(typeId); found != typed.constEnd()) return *found;
+    return *typed.insert(typeId, convert());
 }
 
 bool ClubRepository::saveSetting(const SettingKey &key, const QVariant &value) {
-    return DbUtils::update(
-            d->db,
-            QStringLiteral("insert or replace into settings (name, value) values (?, ?)"),
-            {key, value}).orDefault(0) > 0;
+    if (d->update(QStringLiteral("insert or replace into settings (name, value) values (?, ?)"),
+                  {key, value}).value_or(0) <= 0) {
+        return false;
+    }
+
+    if (d->settings) {
+        // Read back what SQLite made of the value, a bool goes in as 1 rather than "true"
+        d->settings->typedValues.remove(key);
+        if (auto stored = d->queryFirst<QString>(QStringLiteral("select value from settings where name = ?"), {key})) {
+            d->settings->values.insert(key, *stored);
+        } else {
+            d->settings->values.remove(key);
+        }
+    }
+    return true;
 }
 
 bool ClubRepository::removeSetting(const SettingKey &key) {
-    return DbUtils::update(
-            d->db,
-            QStringLiteral("delete from settings where name = ?"),
-            {key}).orDefault(0) > 0;
+    if (d->update(QStringLiteral("delete from settings where name = ?"), {key}).value_or(0) <= 0) {
+        return false;
+    }
+
+    if (d->settings) {
+        d->settings->values.remove(key);
+        d->settings->typedValues.remove(key);
+    }
+    return true;
 }
 
 std::optional<BaseMember> ClubRepository::getMember(MemberId id) const {
@@ -465,28 +1503,40 @@ std::optional<BaseMember> ClubRepository::getMember(MemberId id) const {
                                               QStringLiteral(" and id = ?"),
                                               {id});
 
-    return DbUtils::queryFirst<BaseMember>(d->db, sql, args).toOptional();
+    return d->queryFirst<BaseMember>(sql, args);
 }
 
 bool ClubRepository::withdrawLastGame(SessionId sessionId) {
-    auto rc = DbUtils::update(d->db,
-                              QStringLiteral(
-                                      "delete from games where id = (select id from games where sessionId = ? order by startTime desc limit 1)"),
-                              {sessionId}).orDefault(0) > 0;
+    SQLTransaction tx(d->db);
+
+    auto gameId = d->queryFirst<GameId>(
+            QStringLiteral("select id from games where sessionId = ? order by startTime desc, id desc limit 1"),
+            {sessionId});
+    if (!gameId) return false;
+
+    if (!d->removeGameAllocations(*gameId)) {
+        tx.setError();
+        return false;
+    }
+
+    auto rc = d->update(QStringLiteral("delete from games where id = ?"), {*gameId}).value_or(0) > 0;
     if (rc) {
+        d->reloadLastGame(sessionId);
+        d->forgetGameStats(sessionId);
         emit this->sessionChanged(sessionId);
+        emit gameWithdrawn(sessionId, *gameId);
+    } else {
+        tx.setError();
     }
     return rc;
 }
 
 std::optional<SessionData> ClubRepository::getSession(SessionId sessionId) const {
-    auto session = DbUtils::queryFirst<Session>(d->db, QStringLiteral("select * from sessions where id = ?"),
-                                                {sessionId});
+    auto session = d->queryFirst<Session>(QStringLiteral("select * from sessions where id = ?"), {sessionId});
 
     if (!session) return std::nullopt;
 
-    auto courts = DbUtils::queryList<Court>(d->db, QStringLiteral("select * from courts where sessionId = ?"),
-                                            {sessionId});
+    auto courts = d->queryList<Court>(QStringLiteral("select * from courts where sessionId = ?"), {sessionId});
     if (!courts) return std::nullopt;
 
     return SessionData{*session, *courts};
@@ -494,21 +1544,23 @@ std::optional<SessionData> ClubRepository::getSession(SessionId sessionId) const
 
 std::optional<MemberId> ClubRepository::findMemberBy(QString firstName, QString lastName) {
     sanitizeMemberNames(firstName, lastName);
-    return DbUtils::queryFirst<MemberId>(
-            d->db,
-            QStringLiteral("select id from members where firstName = ? collate nocase and lastName = ? collate nocase"),
-            {firstName, lastName}).toOptional();
+    return d->queryFirst<MemberId>(
+            QStringLiteral("select id from members "
+                           "where lower(trim(firstName)) = lower(?) and lower(trim(lastName)) = lower(?)"),
+            {firstName, lastName});
 }
 
 bool ClubRepository::saveMember(const BaseMember &m) {
-    if (DbUtils::update(
-            d->db,
+    if (d->update(
             QStringLiteral("update members set (firstName, lastName, gender, level, email, phone)"
                            " = (?, ?, ?, ?, ?, ?) where id = ?"),
             {m.firstName, m.lastName, enumToString(m.gender).toLower(), m.level, m.email.trimmed(), m.phone.trimmed(),
              m.id})
-                .orDefault(0) > 0) {
+                .value_or(0) > 0) {
+        if (d->snapshot) d->snapshot->updateMember(m);
+        d->gameStats.clear();
         emit memberChanged();
+        emit memberUpdated(m);
         return true;
     }
 
@@ -516,22 +1568,32 @@ bool ClubRepository::saveMember(const BaseMember &m) {
 }
 
 bool ClubRepository::setPaused(SessionId sessionId, MemberId memberId, bool paused) {
-    if (DbUtils::update(d->db,
-                        QStringLiteral("update players set paused = ? where sessionId = ? and memberId = ?"),
-                        {paused, sessionId, memberId}).orDefault(0) > 0) {
+    if (d->update(QStringLiteral("update players set paused = ? where sessionId = ? and memberId = ?"),
+                  {paused, sessionId, memberId}).value_or(0) > 0) {
+        if (auto snapshot = d->cachedSnapshot(sessionId)) {
+            if (auto member = snapshot->findMember(memberId); member && member->status != Member::CheckedOut) {
+                member->status = paused ? Member::CheckedInPaused : Member::CheckedIn;
+            }
+        }
+
         emit this->sessionChanged(sessionId);
         emit memberChanged();
+        emit pauseChanged(sessionId, memberId, paused);
         return true;
     }
     return false;
 }
 
 bool ClubRepository::setPaid(SessionId sessionId, MemberId memberId, bool paid) {
-    if (DbUtils::update(d->db,
-                        QStringLiteral("update players set paid = ? where sessionId = ? and memberId = ?"),
-                        {paid, sessionId, memberId}).orDefault(0) > 0) {
+    if (d->update(QStringLiteral("update players set paid = ? where sessionId = ? and memberId = ?"),
+                  {paid, sessionId, memberId}).value_or(0) > 0) {
+        if (auto snapshot = d->cachedSnapshot(sessionId)) {
+            if (auto member = snapshot->findMember(memberId)) member->paid = paid;
+        }
+
         emit this->sessionChanged(sessionId);
         emit memberChanged();
+        emit paidChanged(sessionId, memberId, paid);
         return true;
     }
     return false;
@@ -543,11 +1605,12 @@ QString ClubRepository::getClubName() const {
 }
 
 bool ClubRepository::saveClubName(const QString &name) {
-    return saveSetting(skClubName, name);
+    if (!saveSetting(skClubName, name)) return false;
+    emit clubInfoChanged();
+    return true;
 }
 
 LevelRange ClubRepository::getLevelRange() const {
-    SQLTransaction tx(d->db);
     return {
             getSettingValue<unsigned>(skLevelMin).value_or(defaultLevelMin),
             getSettingValue<unsigned>(skLevelMax).value_or(defaultLevelMax)
@@ -559,75 +1622,287 @@ bool ClubRepository::saveClubInfo(const QString &name, LevelRange range) {
         return false;
     }
 
-    SQLTransaction tx(d->db);
-    if (!saveSetting(skLevelMin, range.min) || !saveSetting(skLevelMax, range.max)) {
-        tx.setError();
-        return false;
+    bool saved;
+    {
+        SQLTransaction tx(d->db);
+        saved = saveSetting(skLevelMin, range.min) && saveSetting(skLevelMax, range.max) &&
+                saveSetting(skClubName, name);
+        if (!saved) tx.setError();
     }
 
-    if (!saveSetting(skClubName, name)) {
-        tx.setError();
+    if (!saved) {
+        // The rollback takes back what was already written through to the settings cache
+        if (d->settings) d->loadSettings();
         return false;
     }
 
+    emit clubInfoChanged();
     return true;
 }
 
-size_t
-ClubRepository::importMembers(std::function<bool(BaseMember &)> memberSupplier, QVector<BaseMember> *failMembers) {
-    SQLTransaction tx(d->db);
+// How many imported members go in per transaction, between progress reports
+static const int importChunkSize = 1000;
 
-    size_t success = 0;
-    Member member;
-    while (memberSupplier(member)) {
-        sanitizeMemberNames(member.firstName, member.lastName);
-        if (member.firstName.isEmpty() || member.lastName.isEmpty()) {
-            if (failMembers) failMembers->push_back(member);
-            continue;
+// Names compared the way the member_normalized_names index does: trimmed, and lower case the way SQLite's lower()
+// is, ASCII only
+static QString memberNameKey(const QString &firstName, const QString &lastName) {
+    auto key = firstName.trimmed() + QChar(0) + lastName.trimmed();
+    for (auto &c : key) {
+        if (c >= QLatin1Char('A') && c <= QLatin1Char('Z')) c = QChar(c.unicode() + ('a' - 'A'));
+    }
+    return key;
+}
+
+size_t ClubRepository::importMembers(std::function<bool(BaseMember &)> memberSupplier, QVector<BaseMember> *failMembers,
+                                     const std::function<bool(size_t numRead)> &progress) {
+    // Duplicates are turned away up front rather than by a failed insert each
+    QSet<QString> names;
+    {
+        static const auto sql = QStringLiteral("select firstName, lastName from members");
+        auto profiled = d->profile(sql, {});
+        auto q = d->exec(sql, {});
+        if (!q) return 0;
+
+        int numRows = 0;
+        while (q->next()) {
+            numRows++;
+            names.insert(memberNameKey(q->value(0).toString(), q->value(1).toString()));
         }
+        profiled.setNumRows(numRows);
+        q->finish();
+    }
 
-        auto memberId = DbUtils::insert<MemberId>(
-                d->db,
-                QStringLiteral(
-                        "insert or replace into members (firstName, lastName, gender, level) values (?, ?, ?, ?)"),
-                {member.firstName, member.lastName, enumToString(member.gender).toLower(), member.level});
+    const auto insertSql = QStringLiteral("insert into members (firstName, lastName, gender, level) values (?, ?, ?, ?)");
 
-        if (!memberId) {
-            if (failMembers) failMembers->push_back(member);
-        } else {
-            success++;
+    size_t success = 0, numRead = 0;
+    bool hasMore = true;
+    Member member;
+    while (hasMore) {
+        SQLTransaction tx(d->db);
+
+        int numChunkRead = 0;
+        while (numChunkRead++ < importChunkSize && (hasMore = memberSupplier(member))) {
+            numRead++;
+            sanitizeMemberNames(member.firstName, member.lastName);
+            auto key = memberNameKey(member.firstName, member.lastName);
+            if (member.firstName.isEmpty() || member.lastName.isEmpty() || names.contains(key)) {
+                if (failMembers) failMembers->push_back(member);
+                continue;
+            }
+
+            if (d->insert<MemberId>(insertSql, {member.firstName, member.lastName,
+                                                enumToString(member.gender).toLower(), member.level})) {
+                names.insert(key);
+                success++;
+            } else if (failMembers) {
+                failMembers->push_back(member);
+            }
         }
+
+        if (hasMore && progress && !progress(numRead)) break;
     }
 
+    // New members can't be in a session yet, so the snapshot holds
     emit memberChanged();
+    emit membersImported();
     return success;
 }
 
+// Payments of the sessions in temp.report_sessions, one branch per file so each can go through its indexes
+static const auto paymentRecordsSql = QStringLiteral(
+        "select P.memberId, M.firstName, M.lastName, P.paid, P.sessionId, "
+        "cast(strftime('%s', S.startTime) as integer) "
+        "from temp.report_sessions R "
+        "inner join %1.sessions S on S.id = R.id "
+        "inner join %1.players P on P.sessionId = S.id "
+        "inner join members M on M.id = P.memberId");
+
+bool ClubRepository::forEachPaymentRecord(const QSet<SessionId> &sessionIds,
+                                          const std::function<bool(const PaymentRecord &)> &callback) const {
+    if (sessionIds.isEmpty()) return true;
+
+    SQLTransaction tx(d->db);
+    QSqlQuery q(d->db);
+    if (!q.exec(QStringLiteral("create temp table if not exists report_sessions (id integer primary key)")) ||
+        !q.exec(QStringLiteral("delete from temp.report_sessions"))) {
+        qWarning() << "Unable to list sessions for payment records:" << q.lastError();
+        tx.setError();
+        return false;
+    }
+
+    for (auto id : sessionIds) {
+        if (!d->update(QStringLiteral("insert into temp.report_sessions (id) values (?)"), {id})) {
+            tx.setError();
+            return false;
+        }
+    }
+
+    static const auto mainSql = paymentRecordsSql.arg(QStringLiteral("main"));
+    static const auto withArchiveSql = mainSql + QStringLiteral(" union all ") +
+                                       paymentRecordsSql.arg(QStringLiteral("archive"));
+    const auto &sql = d->archiveAvailable ? withArchiveSql : mainSql;
+    auto profiled = d->profile(sql, {});
+    auto query = d->exec(sql, {});
+    if (!query) {
+        tx.setError();
+        return false;
+    }
+
+    PaymentRecord record;
+    int numRows = 0;
+    while (query->next()) {
+        numRows++;
+        record.memberId = query->value(0).value<MemberId>();
+        record.memberFirstName = query->value(1).toString();
+        record.memberLastName = query->value(2).toString();
+        record.paid = query->value(3).toBool();
+        record.sessionId = query->value(4).value<SessionId>();
+        record.sessionStartTime = query->value(5).toLongLong();
+        if (!callback(record)) break;
+    }
+    profiled.setNumRows(numRows);
+    query->finish();
+    return true;
+}
+
 QVector<PaymentRecord> ClubRepository::getPaymentRecords(const QSet<SessionId> &sessionIds) const {
-    auto sql = QStringLiteral("select M.id as memberId, "
-                              "M.firstName as memberFirstName, "
-                              "M.lastName as memberLastName, "
-                              "M.paid, M.sessionId, (select cast(strftime('%s', startTime) as INTEGER) from sessions where id = M.sessionId) as sessionStartTime from session_members M "
-                              "where M.sessionId in (");
-    for (const auto &id : sessionIds) {
-        sql += QString::number(id);
-        sql += QStringLiteral(",");
+    QVector<PaymentRecord> records;
+    forEachPaymentRecord(sessionIds, [&](const PaymentRecord &record) {
+        records.push_back(record);
+        return true;
+    });
+    return records;
+}
+
+StatementCacheStats ClubRepository::getStatementCacheStats() const {
+    auto stats = d->statementCacheStats;
+    stats.numStatements = d->statements.size();
+    return stats;
+}
+
+void ClubRepository::setStatementCacheEnabled(bool enabled) {
+    d->statementCacheEnabled = enabled;
+    if (!enabled) d->statements.clear();
+}
+
+void ClubRepository::setSessionSnapshotEnabled(bool enabled) {
+    d->snapshotEnabled = enabled;
+}
+
+void ClubRepository::setChangeFlushDelay(int msec) {
+    d->flushTimer.setInterval(msec);
+}
+
+ChangeNotificationStats ClubRepository::getChangeNotificationStats() const {
+    return d->changeStats;
+}
+
+void ClubRepository::flushChanges() {
+    d->flushTimer.stop();
+    if (d->pendingChanges.isEmpty()) return;
+
+    auto changes = std::move(d->pendingChanges);
+    d->pendingChanges = ChangeSet();
+    d->changeStats.numFlushes++;
+    emit changesFlushed(changes);
+}
+
+std::optional<int> ClubRepository::archiveSessions(const QDateTime &startedBefore) {
+    if (!d->archiveAvailable) {
+        qWarning() << "No archive to move sessions to";
+        return std::nullopt;
     }
 
-    sql.replace(sql.length() - 1, 1, QStringLiteral(")"));
+    const auto lastSession = getLastSession();
+
+    // Copied and committed first, then taken out of the club in a transaction of its own. Stopping in between
+    // leaves the sessions in both files, which the next open or archive sorts out.
+    std::optional<int> numSessions;
+    {
+        SQLTransaction tx(d->db);
+        numSessions = d->selectArchivingSessions(
+                QStringLiteral("select id from main.sessions where startTime < ? and id != ?"),
+                {startedBefore.toUTC().toString(QStringLiteral("yyyy-MM-dd HH:mm:ss")), lastSession.value_or(0)});
+        if (!numSessions || (*numSessions > 0 && !d->copyToArchive())) {
+            tx.setError();
+            return std::nullopt;
+        }
+    }
+
+    if (*numSessions > 0) {
+        SQLTransaction tx(d->db);
+        if (!d->deleteArchived()) {
+            tx.setError();
+            return std::nullopt;
+        }
+    }
+
+    if (*numSessions > 0) {
+        d->snapshot.reset();
+        d->gameStats.clear();
+        qDebug() << "Archived" << *numSessions << "sessions";
+    }
+    return numSessions;
+}
+
+bool ClubRepository::runMaintenance() {
+    // Turning archiving on takes effect when the club is next opened, which is when the archive file is made
+    const auto months = getSettingValue<int>(skArchiveAfterMonths).value_or(defaultArchiveAfterMonths);
+    if (months > 0 && d->archiveAvailable && !archiveSessions(QDateTime::currentDateTimeUtc().addMonths(-months))) {
+        return false;
+    }
+
+    QStringList sqls = {
+            QStringLiteral("analyze"),
+            QStringLiteral("vacuum main"),
+    };
+    if (d->archiveAvailable) sqls << QStringLiteral("vacuum archive");
+    sqls << QStringLiteral("pragma wal_checkpoint(truncate)");
+
+    QSqlQuery q(d->db);
+    for (const auto &sql : sqls) {
+        if (!q.exec(sql)) {
+            qWarning() << "Error executing sql " << sql << ":" << q.lastError();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ClubRepository::runMaintenanceAsync(QObject *context, std::function<void(bool)> callback) {
+    QPointer<QObject> contextAlive(context);
+    auto finished = [=](bool ok) {
+        // Sessions may have left the club's file from under what's cached
+        d->snapshot.reset();
+        d->gameStats.clear();
+        if (contextAlive) callback(ok);
+    };
+
+    if (!d->readPool) {
+        finished(runMaintenance());
+        return;
+    }
 
-    return DbUtils::queryList<PaymentRecord>(d->db, sql).orDefault();
+    auto watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [watcher, finished] {
+        finished(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(d->readPool.get(), [path = d->path] {
+        std::unique_ptr<ClubRepository> writer(openWriter(path));
+        return writer && writer->runMaintenance();
+    }));
 }
 
 QVector<Session> ClubRepository::getAllSessions(std::optional<size_t> limit) {
-    auto sql = QStringLiteral("select * from sessions order by startTime desc, id desc");
+    auto sql = QStringLiteral("select * from all_sessions order by startTime desc, id desc");
     QVector<QVariant> args;
     if (limit) {
         sql += QStringLiteral(" limit ?");
         args.push_back(QVariant::fromValue(*limit));
     }
 
-    return DbUtils::queryList<Session>(d->db, sql, args).orDefault();
+    return d->queryList<Session>(sql, args).value_or(QVector<Session>());
 }
 
 
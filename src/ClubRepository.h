@@ -2,8 +2,14 @@
 #define GAMEREPOSITORY_H
 
 #include <QObject>
+#include <QStringList>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 #include <optional>
 #include <functional>
+#include <type_traits>
 
 #include "models.h"
 #include "MemberFilter.h"
@@ -11,11 +17,14 @@
 #include "ClubRepositoryModels.h"
 
 class QFile;
+class QThreadPool;
+class CoPlayHistory;
 
 class ClubRepository : public QObject {
 Q_OBJECT
 public:
-    static ClubRepository *open(QObject *parent, const QString &path);
+    static ClubRepository *open(QObject *parent, const QString &path,
+                                const DatabaseProfile &profile = DatabaseProfile());
 
     ~ClubRepository() override;
 
@@ -34,13 +43,9 @@ public:
 
     template <typename T>
     std::optional<T> getSettingValue(const SettingKey &key) const {
-        auto stringValue = getSetting(key);
-        if (!stringValue) return std::nullopt;
-
-        QVariant variant = *stringValue;
         static auto typeId = qMetaTypeId<T>();
-        if (variant.convert(typeId)) {
-            return variant.value<T>();
+        if (auto variant = getSettingVariant(key, typeId)) {
+            return variant->template value<T>();
         }
 
         return std::nullopt;
@@ -55,7 +60,11 @@ public:
             QString phone, QString email);
 
     bool saveMember(const BaseMember &);
-    size_t importMembers(std::function<bool(BaseMember&)> memberSupplier, QVector<BaseMember> *failMembers = nullptr);
+    // Members are taken from the supplier until it returns false and go in by the thousand, one transaction
+    // each. Blank and duplicated names end up in `failMembers`. `progress` hears how many have been read
+    // after every chunk and can stop the import by returning false, keeping what has gone in so far.
+    size_t importMembers(std::function<bool(BaseMember&)> memberSupplier, QVector<BaseMember> *failMembers = nullptr,
+                         const std::function<bool(size_t numRead)> &progress = nullptr);
 
     QVector<Member> findMember(MemberSearchFilter, const QString &needle) const;
 
@@ -65,6 +74,9 @@ public:
 
     QVector<Member> getMembers(MemberSearchFilter) const;
 
+    // How SQLite runs getMembers for the filter, as reported by EXPLAIN QUERY PLAN
+    QStringList getMembersQueryPlan(MemberSearchFilter) const;
+
     bool checkIn(SessionId sessionId, MemberId memberId, bool paid);
 
     bool checkOut(SessionId, MemberId);
@@ -82,14 +94,80 @@ public:
 
     QVector<GameAllocation> getPastAllocations(SessionId id) const;
 
+    // Allocations of the games made after the given one, in the order they were made
+    QVector<GameAllocation> getAllocationsSince(SessionId, std::optional<GameId> afterGameId) const;
+
+    int getNumGames(SessionId) const;
+
+    // Counts the database keeps for every player of the session as games are made and withdrawn, by member
+    QHash<MemberId, PlayerCounters> getPlayerCounters(SessionId) const;
+
     MemberGameStats getMemberGameStats(MemberId, SessionId) const;
 
     std::optional<GameId> createGame(SessionId, const QVector<GameAllocation> &, qlonglong durationSeconds);
 
+    bool replaceGameAllocations(SessionId, GameId, const QVector<GameAllocation> &);
+
+    // Pairs from the excluded session's games are left out, as the matcher already counts the session's own games
+    CoPlayHistory getCoPlayHistory(std::optional<SessionId> excludedSession = std::nullopt) const;
+
     QVector<PaymentRecord> getPaymentRecords(const QSet<SessionId> &) const;
 
+    // Hands the records to `callback` as they are read, until it returns false
+    bool forEachPaymentRecord(const QSet<SessionId> &,
+                              const std::function<bool(const PaymentRecord &)> &callback) const;
+
+    // Archived sessions included, as are their payment records above
     QVector<Session> getAllSessions(std::optional<size_t> limit = std::nullopt);
 
+    // Moves sessions that started before the given time, along with their courts, players and games, out of the
+    // club's file into the archive next to it. The last session stays so it can be resumed. Returns how many
+    // sessions were moved. Fails when the club has no archive: the archive file is made when the club is opened
+    // with the archive_after_months setting on.
+    std::optional<int> archiveSessions(const QDateTime &startedBefore);
+
+    // Archives sessions past the club's archive age (none unless the archive_after_months setting is on),
+    // refreshes the query planner's statistics and hands back the space freed. Meant for when no session is
+    // on, as the database is locked while it runs.
+    bool runMaintenance();
+
+    // As above, on the database thread with a connection of its own so the calling thread carries on.
+    // A club kept in memory can't be opened twice, so it runs straight away. The result goes to `callback`
+    // on this repository's thread unless `context` has gone by then.
+    void runMaintenanceAsync(QObject *context, std::function<void(bool)> callback);
+
+    StatementCacheStats getStatementCacheStats() const;
+    void setStatementCacheEnabled(bool);
+
+    // Reads go to the database when disabled, while a snapshot already loaded keeps following changes
+    void setSessionSnapshotEnabled(bool);
+
+    // How long changes are collected before changesFlushed, 0 flushes on the next event loop iteration
+    void setChangeFlushDelay(int msec);
+    ChangeNotificationStats getChangeNotificationStats() const;
+
+    // Runs `read` on the repository's database thread, against a read only connection of its own, and
+    // hands the result back as a future. `read` is given that thread's repository and must stick to it.
+    // A club kept in memory can't be opened twice, so its reads run straight away on the calling thread.
+    template <typename Read>
+    auto readAsync(Read read) const -> QFuture<std::invoke_result_t<Read, const ClubRepository &>>;
+
+    // As above, with the result handed to `callback` on `context`'s thread unless it has gone by then
+    template <typename Read, typename Callback>
+    void readAsync(Read read, QObject *context, Callback callback) const;
+
+    // Whether readerForCurrentThread() gives other threads a connection, false for a club kept in memory
+    bool canReadOnAnyThread() const;
+
+    // A read only repository with its own connection for the calling thread, so workers such as the matcher
+    // can read while this one writes. On this repository's own thread that is the repository itself.
+    // Null when canReadOnAnyThread() is false. It is closed on its own thread when that thread finishes, which
+    // for a pool thread can be after this repository is gone.
+    const ClubRepository *readerForCurrentThread() const;
+
+public slots:
+    void flushChanges();
+
 
 signals:
 
@@ -97,11 +175,68 @@ signals:
     void memberChanged();
     void sessionChanged(SessionId);
 
+    // Fine grained changes, emitted after the coarse signals above so a listener can patch instead of reloading
+    void playerCheckedIn(SessionId, const Member &);
+    void playerCheckedOut(SessionId, MemberId);
+    void paidChanged(SessionId, MemberId, bool paid);
+    void pauseChanged(SessionId, MemberId, bool paused);
+    void gameCreated(SessionId, GameId);
+    void gameChanged(SessionId, GameId);
+    void gameWithdrawn(SessionId, GameId);
+    void memberCreated(const BaseMember &);
+    void memberUpdated(const BaseMember &);
+    void membersImported();
+    void sessionCreated(SessionId);
+
+    // All changes since the last flush in one batch, views that reload wholesale should listen to this
+    void changesFlushed(const ChangeSet &);
+
 private:
     struct Impl;
     Impl *d;
 
     ClubRepository(QObject *parent, Impl *);
+
+    static ClubRepository *openReader(const QString &path);
+
+    // A connection that can write, for work handed off to the database thread
+    static ClubRepository *openWriter(const QString &path);
+
+    // The setting converted to `typeId`, remembered until the setting changes
+    std::optional<QVariant> getSettingVariant(const SettingKey &key, int typeId) const;
+
+    // The database thread, or null when reads can't leave the calling thread
+    QThreadPool *readThread() const;
+
 };
 
+template <typename Read>
+auto ClubRepository::readAsync(Read read) const -> QFuture<std::invoke_result_t<Read, const ClubRepository &>> {
+    typedef std::invoke_result_t<Read, const ClubRepository &> Result;
+
+    if (auto pool = readThread()) {
+        return QtConcurrent::run(pool, [this, read] {
+            auto reader = readerForCurrentThread();
+            return reader ? read(*reader) : Result();
+        });
+    }
+
+    QFutureInterface<Result> result(QFutureInterfaceBase::Started);
+    result.reportResult(read(*this));
+    result.reportFinished();
+    return result.future();
+}
+
+template <typename Read, typename Callback>
+void ClubRepository::readAsync(Read read, QObject *context, Callback callback) const {
+    typedef std::invoke_result_t<Read, const ClubRepository &> Result;
+
+    auto watcher = new QFutureWatcher<Result>(context);
+    QObject::connect(watcher, &QFutureWatcherBase::finished, context, [watcher, callback] {
+        callback(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(readAsync(std::move(read)));
+}
+
 #endif // GAMEREPOSITORY_H
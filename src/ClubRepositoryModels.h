@@ -6,6 +6,8 @@
 #define GAMEMATCHER_CLUBREPOSITORYMODELS_H
 
 #include "models.h"
+#include <QSet>
+#include <optional>
 
 struct CourtConfiguration {
     QString name;
@@ -76,6 +78,18 @@ struct MemberGameStats {
     QVector<PastGame> pastGames;
 };
 
+// A player's games in a session, kept by triggers on game_allocations
+struct PlayerCounters {
+    int gamesPlayed = 0;
+    std::optional<GameId> lastGameId;
+
+    // Seconds since epoch, 0 until the first game
+    qlonglong lastPlayedAt = 0;
+
+    // Games since the last one played, or all of them
+    int numGamesOff = 0;
+};
+
 struct LevelRange {
 Q_GADGET
 public:
@@ -107,4 +121,72 @@ public:
     DECLARE_PROPERTY(qlonglong, sessionStartTime,  = 0);
 };
 
+// SQLite settings applied when a club file is opened
+struct DatabaseProfile {
+    QString journalMode = QStringLiteral("WAL");
+    QString synchronous = QStringLiteral("NORMAL");
+    qint64 mmapSize = 64 * 1024 * 1024;
+    int cacheSizeKiB = 8 * 1024;
+    bool tempStoreInMemory = true;
+    int busyTimeoutMs = 5000;
+
+    // What SQLite does when nothing is set
+    static DatabaseProfile sqliteDefaults() {
+        DatabaseProfile profile;
+        profile.journalMode = QStringLiteral("DELETE");
+        profile.synchronous = QStringLiteral("FULL");
+        profile.mmapSize = 0;
+        profile.cacheSizeKiB = 2000;
+        profile.tempStoreInMemory = false;
+        profile.busyTimeoutMs = 0;
+        return profile;
+    }
+};
+
+struct StatementCacheStats {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    int numStatements = 0;
+};
+
+// Everything that changed since the last ClubRepository::changesFlushed
+struct ChangeSet {
+    // Sessions whose players or games changed
+    QSet<SessionId> sessions;
+
+    // Sessions where only paid or paused flags changed, which a view may have patched already
+    QSet<SessionId> playerFlags;
+
+    bool members = false;
+    bool clubInfo = false;
+
+    // Members created or updated. An import may have touched any of them, which sets allMembers instead.
+    QSet<MemberId> memberIds;
+    bool allMembers = false;
+
+    bool isEmpty() const {
+        return sessions.isEmpty() && playerFlags.isEmpty() && !members && !clubInfo;
+    }
+
+    bool affects(SessionId sessionId) const {
+        return members || sessions.contains(sessionId) || playerFlags.contains(sessionId);
+    }
+
+    bool affectsAnyMember(const QSet<MemberId> &ids) const {
+        return allMembers || memberIds.intersects(ids);
+    }
+};
+
+Q_DECLARE_METATYPE(ChangeSet);
+
+struct ChangeNotificationStats {
+    quint64 numChanges = 0;
+    quint64 numFlushes = 0;
+
+    // Every change a listener would have reloaded for, less the batches it actually got
+    quint64 numAvoided() const {
+        return numChanges - numFlushes;
+    }
+};
+
 #endif //GAMEMATCHER_CLUBREPOSITORYMODELS_H
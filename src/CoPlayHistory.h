@@ -0,0 +1,56 @@
+#ifndef GAMEMATCHER_COPLAYHISTORY_H
+#define GAMEMATCHER_COPLAYHISTORY_H
+
+#include "models.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <algorithm>
+
+// How often two members have played on the same court, across all sessions.
+// Counts are decayed by how long ago the pair last played together.
+class CoPlayHistory {
+public:
+    typedef quint64 PairKey;
+
+    static inline PairKey pairKey(MemberId a, MemberId b) {
+        if (a > b) std::swap(a, b);
+        return (static_cast<PairKey>(a) << 32) | static_cast<PairKey>(b);
+    }
+
+    void insert(PairKey key, qreal weight) {
+        if (weight > 0) weights_.insert(key, weight);
+    }
+
+    qreal weight(MemberId a, MemberId b) const {
+        return weights_.value(pairKey(a, b), 0);
+    }
+
+    bool isEmpty() const { return weights_.isEmpty(); }
+
+    int size() const { return weights_.size(); }
+
+    // Percentage of the pairs in this group that have a significant history together.
+    int repeatScore(const QVector<MemberId> &players) const {
+        if (weights_.isEmpty() || players.size() < 2) return 0;
+
+        qreal sum = 0;
+        int numPairs = 0;
+        for (int i = 0, size = players.size(); i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                sum += std::min<qreal>(weight(players[i], players[j]), saturatedWeight);
+                numPairs++;
+            }
+        }
+
+        return static_cast<int>(sum * 100 / (numPairs * saturatedWeight));
+    }
+
+private:
+    static constexpr qreal saturatedWeight = 4;
+
+    QHash<PairKey, qreal> weights_;
+};
+
+#endif //GAMEMATCHER_COPLAYHISTORY_H
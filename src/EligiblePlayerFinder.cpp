@@ -4,6 +4,7 @@
 
 #include "EligiblePlayerFinder.h"
 #include "GameStats.h"
+#include "RotationTracker.h"
 
 #include <algorithm>
 
@@ -67,3 +68,9 @@ EligiblePlayerFinder::findEligiblePlayers(const QVector<BasePlayerInfo> &members
 
     return players;
 }
+
+QVector<PlayerInfo>
+EligiblePlayerFinder::findEligiblePlayers(const RotationTracker &rotation, unsigned playerPerCourt,
+                                          unsigned numCourt) {
+    return rotation.findEligiblePlayers(playerPerCourt, numCourt);
+}
@@ -11,11 +11,15 @@
 #include <QVector>
 
 class GameStats;
+class RotationTracker;
 
 class EligiblePlayerFinder {
 public:
     static QVector<PlayerInfo> findEligiblePlayers(const QVector<BasePlayerInfo> &members, unsigned playerPerCourt,
                                                    unsigned numCourt, const GameStats *stats);
+
+    static QVector<PlayerInfo> findEligiblePlayers(const RotationTracker &rotation, unsigned playerPerCourt,
+                                                   unsigned numCourt);
 };
 
 
@@ -12,14 +12,21 @@
 #include "ReportsDialog.h"
 #include "MemberListDialog.h"
 
+#include <QApplication>
 #include <QRandomGenerator>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QTextStream>
+#include <QTimer>
+
+// How long nobody has to touch the app before the database is tidied up
+static const int maintenanceDelayMs = 10 * 60 * 1000;
 
 struct EmptySessionPage::Impl {
     ClubRepository *const repo;
     Ui::EmptySessionPage ui;
+    QTimer maintenanceTimer;
+    bool maintenanceStarted = false;
 };
 
 EmptySessionPage::EmptySessionPage(ClubRepository *repo, QWidget *parent)
@@ -33,8 +40,22 @@ EmptySessionPage::EmptySessionPage(ClubRepository *repo, QWidget *parent)
 #endif
 
     reload();
-    connect(d->repo, &ClubRepository::clubInfoChanged, this, &EmptySessionPage::reload);
-    connect(d->repo, &ClubRepository::sessionChanged, this, &EmptySessionPage::reload);
+    connect(d->repo, &ClubRepository::changesFlushed, this, [=](const ChangeSet &changes) {
+        if (changes.clubInfo || !changes.sessions.isEmpty()) reload();
+    });
+
+    // No session is on while this page is up, so the database can be archived and compacted once. Any input
+    // to the app starts the wait over, see eventFilter().
+    d->maintenanceTimer.setSingleShot(true);
+    d->maintenanceTimer.setInterval(maintenanceDelayMs);
+    connect(&d->maintenanceTimer, &QTimer::timeout, this, [=] {
+        d->maintenanceStarted = true;
+        d->repo->runMaintenanceAsync(this, [](bool ok) {
+            if (!ok) qWarning() << "Database maintenance didn't finish";
+        });
+    });
+    d->maintenanceTimer.start();
+    qApp->installEventFilter(this);
 
     connect(d->ui.closeButton, &QPushButton::clicked, this, &EmptySessionPage::clubClosed);
     connect(d->ui.resumeButton, &QPushButton::clicked, this, &EmptySessionPage::lastSessionResumed);
@@ -125,9 +146,25 @@ EmptySessionPage::EmptySessionPage(ClubRepository *repo, QWidget *parent)
 }
 
 EmptySessionPage::~EmptySessionPage() {
+    qApp->removeEventFilter(this);
     delete d;
 }
 
+bool EmptySessionPage::eventFilter(QObject *watched, QEvent *event) {
+    switch (event->type()) {
+        case QEvent::KeyPress:
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseMove:
+        case QEvent::Wheel:
+        case QEvent::TouchBegin:
+            if (!d->maintenanceStarted) d->maintenanceTimer.start();
+            break;
+        default:
+            break;
+    }
+    return QFrame::eventFilter(watched, event);
+}
+
 void EmptySessionPage::reload() {
     d->ui.clubNameLabel->setText(tr("Welcome to %1").arg(d->repo->getClubName()));
     d->ui.resumeButton->setEnabled(d->repo->getLastSession().has_value());
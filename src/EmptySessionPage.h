@@ -16,6 +16,8 @@ public:
 
     ~EmptySessionPage() override;
 
+    bool eventFilter(QObject *, QEvent *) override;
+
     signals:
     void newSessionCreated();
     void lastSessionResumed();
@@ -2,6 +2,7 @@
 
 #include <QtDebug>
 #include <QHash>
+#include <QSet>
 
 #include <algorithm>
 
@@ -9,13 +10,17 @@
 #include "BFCombinationFinder.h"
 #include "SortingLevelCombinationFinder.h"
 #include "EligiblePlayerFinder.h"
+#include "MatchingScore.h"
+#include "RotationTracker.h"
 
 QVector<GameAllocation>
 GameMatcher::match(const QVector<GameAllocation> &pastAllocations,
                    const QVector<Member> &allPlayers,
                    const QVector<CourtId> &courtIds,
                    unsigned playerPerCourt,
-                   int seed) {
+                   int seed,
+                   const CoPlayHistory *coPlayHistory,
+                   const RotationTracker *rotation) {
     qDebug() << "Matching using " << pastAllocations.size() << " past allocations, " << allPlayers.size()
              << " players and "
              << courtIds.size() << " courts";
@@ -29,16 +34,184 @@ GameMatcher::match(const QVector<GameAllocation> &pastAllocations,
         players.push_back(BasePlayerInfo(p));
     }
 
-    if (pastAllocations.isEmpty()) {
+    // The first game of a session still has the players' history from earlier sessions to go by
+    if (pastAllocations.isEmpty() && (!coPlayHistory || coPlayHistory->isEmpty())) {
         finder = std::make_unique<SortingLevelCombinationFinder>(playerPerCourt, seed);
     } else {
-        stats = std::make_unique<GameStatsImpl>(pastAllocations);
+        auto statsImpl = std::make_unique<GameStatsImpl>(pastAllocations);
+        statsImpl->setCoPlayHistory(coPlayHistory);
+        stats = std::move(statsImpl);
         finder = std::make_unique<BFCombinationFinder>(playerPerCourt, *stats);
     }
 
+    std::optional<RotationTracker> sessionRotation;
+    if (!rotation) {
+        rotation = &sessionRotation.emplace(pastAllocations);
+        for (const auto &p : players) {
+            sessionRotation->setActive(p, true);
+        }
+    }
+
     return finder->find(
             courtIds,
-            EligiblePlayerFinder::findEligiblePlayers(
-                    players, playerPerCourt, courtIds.size(), stats.get()));
+            EligiblePlayerFinder::findEligiblePlayers(*rotation, playerPerCourt, courtIds.size()));
+}
+
+typedef std::vector<const BasePlayerInfo *> PlayerPointers;
+
+static void findBestFill(const GameStats &stats,
+                         const PlayerPointers &candidates, size_t start, size_t numRequired,
+                         PlayerPointers &court, int minLevel, int maxLevel,
+                         std::optional<std::pair<int, PlayerPointers>> &best) {
+    if (numRequired == 0) {
+        auto score = MatchingScore::computeCourtScore(stats, court, minLevel, maxLevel);
+        if (!best || score > best->first) {
+            best.emplace(score, court);
+        }
+        return;
+    }
+
+    for (auto i = start; i + numRequired <= candidates.size(); i++) {
+        court.push_back(candidates[i]);
+        findBestFill(stats, candidates, i + 1, numRequired - 1, court, minLevel, maxLevel, best);
+        court.pop_back();
+    }
 }
 
+QVector<GameAllocation>
+GameMatcher::repair(const QVector<GameAllocation> &pastAllocations,
+                    const QVector<GameAllocation> &currentGame,
+                    const QVector<Member> &availablePlayers,
+                    const QVector<CourtId> &courtIds,
+                    unsigned playerPerCourt) {
+    if (currentGame.isEmpty() || playerPerCourt == 0) return {};
+
+    const auto gameId = currentGame.first().gameId;
+
+    QVector<GameAllocation> history;
+    history.reserve(pastAllocations.size());
+    for (const auto &allocation : pastAllocations) {
+        if (allocation.gameId != gameId) history.push_back(allocation);
+    }
+    GameStatsImpl stats(history);
+
+    QHash<MemberId, BasePlayerInfo> available;
+    std::optional<int> minLevel, maxLevel;
+    for (const auto &m : availablePlayers) {
+        available.insert(m.id, BasePlayerInfo(m));
+        if (!minLevel || m.level < *minLevel) minLevel = m.level;
+        if (!maxLevel || m.level > *maxLevel) maxLevel = m.level;
+    }
+
+    if (available.isEmpty()) return {};
+    if (*minLevel == *maxLevel) (*maxLevel)++;
+
+    struct Court {
+        CourtId id;
+        int quality;
+        PlayerPointers players;
+    };
+
+    QVector<Court> courts;
+    QSet<MemberId> onCourt;
+    for (const auto &allocation : currentGame) {
+        if (courts.isEmpty() || courts.last().id != allocation.courtId) {
+            courts.push_back(Court{allocation.courtId, allocation.quality});
+        }
+
+        onCourt.insert(allocation.memberId);
+        if (auto found = available.constFind(allocation.memberId); found != available.constEnd()) {
+            courts.last().players.push_back(&found.value());
+        }
+    }
+
+    PlayerPointers bench;
+    for (const auto &m : availablePlayers) {
+        if (!onCourt.contains(m.id)) bench.push_back(&available.constFind(m.id).value());
+    }
+
+    // Empty courts only get players when the bench has enough left after the vacated seats
+    for (auto courtId : courtIds) {
+        if (std::none_of(courts.begin(), courts.end(), [=](const Court &c) { return c.id == courtId; })) {
+            courts.push_back(Court{courtId, 0});
+        }
+    }
+
+    // Release the courts we can't fill, starting from the one that lost the most players
+    QVector<Court *> affected;
+    for (auto &court : courts) {
+        if (court.players.size() < playerPerCourt) affected.push_back(&court);
+    }
+
+    std::stable_sort(affected.begin(), affected.end(), [](const Court *a, const Court *b) {
+        return a->players.size() > b->players.size();
+    });
+
+    size_t numBenchAvailable = bench.size();
+    QVector<Court *> toFill;
+    for (auto court : affected) {
+        auto numVacated = playerPerCourt - court->players.size();
+        if (numVacated <= numBenchAvailable) {
+            numBenchAvailable -= numVacated;
+            toFill.push_back(court);
+        } else {
+            numBenchAvailable += court->players.size();
+            bench.insert(bench.end(), court->players.begin(), court->players.end());
+            court->players.clear();
+        }
+    }
+
+    // Same rule as EligiblePlayerFinder: people who have been waiting longest get the seats first
+    auto eligibility = [&](const BasePlayerInfo *p) {
+        return stats.numGamesOff(p->memberId) * 2000 - stats.numGamesFor(p->memberId);
+    };
+
+    std::stable_sort(bench.begin(), bench.end(), [&](const BasePlayerInfo *a, const BasePlayerInfo *b) {
+        return eligibility(a) > eligibility(b);
+    });
+
+    for (auto court : toFill) {
+        const size_t numVacated = playerPerCourt - court->players.size();
+        const auto threshold = eligibility(bench[numVacated - 1]);
+
+        // Everyone above the threshold must be on; the rest of the seats go to the best match among the ties.
+        auto players = court->players;
+        PlayerPointers candidates;
+        for (auto p : bench) {
+            auto score = eligibility(p);
+            if (score > threshold) {
+                players.push_back(p);
+            } else if (score < threshold || candidates.size() >= numVacated + playerPerCourt) {
+                break;
+            } else {
+                candidates.push_back(p);
+            }
+        }
+
+        std::optional<std::pair<int, PlayerPointers>> best;
+        findBestFill(stats, candidates, 0, playerPerCourt - players.size(), players, *minLevel, *maxLevel, best);
+        if (!best) {
+            court->players.clear();
+            continue;
+        }
+
+        for (auto p : best->second) {
+            if (auto found = std::find(bench.begin(), bench.end(), p); found != bench.end()) {
+                bench.erase(found);
+            }
+        }
+
+        court->players = best->second;
+        court->quality = best->first;
+    }
+
+    QVector<GameAllocation> result;
+    for (const auto &court : courts) {
+        if (court.players.size() != playerPerCourt) continue;
+        for (auto p : court.players) {
+            result.push_back(GameAllocation(gameId, court.id, p->memberId, court.quality));
+        }
+    }
+
+    return result;
+}
@@ -5,14 +5,30 @@
 
 #include <QVector>
 
+class CoPlayHistory;
+class RotationTracker;
+
 class GameMatcher {
 public:
+    // The rotation, when given, must already have the past allocations and the members as its active players.
     static QVector<GameAllocation>
     match(const QVector<GameAllocation> &pastAllocation,
           const QVector<Member> &members,
           const QVector<CourtId> &courts,
           unsigned playerPerCourt,
-          int seed);
+          int seed,
+          const CoPlayHistory *coPlayHistory = nullptr,
+          const RotationTracker *rotation = nullptr);
+
+    // Fix up an existing game after players left, paused or joined: courts that still have all their players
+    // are kept, vacated seats are filled from the bench and a court that can't be filled is released. Courts the
+    // game doesn't use are opened for the bench, players who joined first, once there are enough for one.
+    static QVector<GameAllocation>
+    repair(const QVector<GameAllocation> &pastAllocation,
+           const QVector<GameAllocation> &currentGame,
+           const QVector<Member> &availablePlayers,
+           const QVector<CourtId> &courts,
+           unsigned playerPerCourt);
 };
 
 #endif // GAMEMATCHER_H
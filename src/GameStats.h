@@ -7,11 +7,10 @@
 
 #include <QSet>
 #include <map>
-#include <QJsonObject>
-#include <QJsonArray>
 
 #include "models.h"
 #include "PlayerInfo.h"
+#include "CoPlayHistory.h"
 
 
 class GameStats {
@@ -30,6 +29,7 @@ public:
 class GameStatsImpl : public GameStats {
     std::map<GameId, std::map<CourtId, QSet<MemberId>>> games;
     int numTotalGames = 0;
+    const CoPlayHistory *coPlayHistory = nullptr;
 
 public:
 
@@ -41,47 +41,6 @@ public:
         numTotalGames = games.size();
     }
 
-    explicit GameStatsImpl(const QJsonObject &obj) {
-        numTotalGames = obj[QStringLiteral("numTotalGames")].toInt();
-        auto gameObj = obj[QStringLiteral("games")].toObject();
-        for (auto iter = gameObj.begin(); iter != gameObj.end(); ++iter) {
-            bool ok;
-            if (auto gameId = iter.key().toLongLong(&ok); ok) {
-                auto &game = games[gameId];
-                auto courtsObj = iter.value().toObject();
-                for (auto courtIter = courtsObj.begin(); courtIter != courtsObj.end(); ++courtIter) {
-                    if (auto courtId = courtIter.key().toLongLong(&ok); ok) {
-                        auto &courtPlayers = game[courtId];
-                        for (auto v : courtIter.value().toArray()) {
-                            courtPlayers.insert(v.toInt());
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-    QJsonObject toJson() const {
-        QJsonObject gamesObj;
-        for (const auto &[id, game]: games) {
-            QJsonObject courtObj;
-            for (const auto &[courtId, players] : game) {
-                QJsonArray memberArray;
-                for (auto p : players) {
-                    memberArray += p;
-                }
-
-                courtObj[QString::number(courtId)] = memberArray;
-            }
-            gamesObj[QString::number(id)] = courtObj;
-        }
-
-        return {
-                {QStringLiteral("numTotalGames"), numTotalGames,},
-                {QStringLiteral("games"),         gamesObj},
-        };
-    }
-
     int numGamesFor(MemberId memberId) const override {
         int rc = 0;
         for (const auto &[id, courts] : games) {
@@ -110,8 +69,13 @@ public:
 
     int numGames() const override { return this->numTotalGames; }
 
+    // Should leave out this session's games, they are already counted from the allocations
+    void setCoPlayHistory(const CoPlayHistory *history) { coPlayHistory = history; }
+
     int similarityScore(const QVector<MemberId> &players) const override {
-        if (games.empty()) return 0;
+        // Groupings from previous sessions weigh half as much as the ones from this session
+        const int crossSessionScore = coPlayHistory ? coPlayHistory->repeatScore(players) / 2 : 0;
+        if (games.empty()) return crossSessionScore;
 
         int totalSeats = 0;
         int sum = 0;
@@ -131,8 +95,8 @@ public:
             }
         }
 
-        if (totalSeats == 0) return 0;
-        return sum * 100 / totalSeats;
+        if (totalSeats == 0) return crossSessionScore;
+        return sum * 100 / totalSeats + crossSessionScore;
     }
 };
 
@@ -14,6 +14,8 @@
 
 #include <optional>
 
+static const SettingKey skLastSelectedCourts = QStringLiteral("last_selected_courts");
+
 struct LastSelectedCourt {
     SessionId sessionId = 0;
     QSet<CourtId> selectedCourts;
@@ -14,7 +14,9 @@
 #include <QFutureWatcher>
 #include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QComboBox>
 #include <functional>
 #include <memory>
@@ -92,8 +94,10 @@ static QStringList readHeaders(const QString &fileName) {
     return stream.readLine(512).split(QStringLiteral(","));
 }
 
+// Reads the file one line at a time. `position` is given a way to tell how far into the file reading has got.
 static std::function<bool(BaseMember &)>
-readAll(const QString &filePath, const QHash<QString, const PropertyWriter *> &propMaps) {
+readAll(const QString &filePath, const QHash<QString, const PropertyWriter *> &propMaps,
+        std::function<qint64()> *position = nullptr) {
     struct Context {
         QFile file;
         QTextStream stream;
@@ -108,6 +112,10 @@ readAll(const QString &filePath, const QHash<QString, const PropertyWriter *> &p
     ctx->stream.setDevice(&ctx->file);
     ctx->headerNames = ctx->stream.readLine(512).split(QStringLiteral(","));
 
+    if (position) {
+        *position = [ctx] { return ctx->file.pos(); };
+    }
+
     return [ctx, propMaps](BaseMember &m) -> bool {
         if (!ctx->stream.readLineInto(&ctx->line, 512)) return false;
 
@@ -228,8 +236,25 @@ void MemberImportDialog::reload() {
 }
 
 void MemberImportDialog::accept() {
+    std::function<qint64()> position;
+    auto reader = readAll(d->ui.pathLabel->text(), d->getPropertyMap(), &position);
+    if (!reader) {
+        QMessageBox::warning(this, tr("Import result"), tr("Unable to open %1").arg(d->ui.pathLabel->text()));
+        return;
+    }
+
+    QProgressDialog progressDialog(tr("Importing members..."), tr("Stop"), 0, 100, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(500);
+
+    const auto fileSize = std::max<qint64>(1, QFileInfo(d->ui.pathLabel->text()).size());
     QVector<BaseMember> failure;
-    auto numSuccess = d->repo->importMembers(readAll(d->ui.pathLabel->text(), d->getPropertyMap()), &failure);
+    auto numSuccess = d->repo->importMembers(reader, &failure, [&](size_t) {
+        progressDialog.setValue(static_cast<int>(position() * 100 / fileSize));
+        return !progressDialog.wasCanceled();
+    });
+    progressDialog.reset();
+
     auto body = tr("Number of success imports: %1").arg(numSuccess);
     if (!failure.isEmpty()) {
         body += tr("\nFailed imports: %1").arg(failure.size());
@@ -93,7 +93,9 @@ MemberListDialog::MemberListDialog(ClubRepository *repo, QWidget *parent)
     d->ui.memberWidget->setColumnCount(labels.size());
     d->ui.memberWidget->setHorizontalHeaderLabels(labels);
 
-    connect(d->repo, &ClubRepository::memberChanged, this, &MemberListDialog::reload);
+    connect(d->repo, &ClubRepository::changesFlushed, this, [=](const ChangeSet &changes) {
+        if (changes.members) reload();
+    });
 
     connect(d->ui.memberWidget, &QTableWidget::itemChanged, [=](QTableWidgetItem * item) {
         if (d->isUpdatingList) return;
@@ -0,0 +1,94 @@
+#include "MemberSearchIndex.h"
+
+#include <QSet>
+#include <QStringList>
+
+#include <algorithm>
+#include <optional>
+
+static bool nameOrder(const Member &lhs, const Member &rhs) {
+    if (lhs.firstName != rhs.firstName) return lhs.firstName < rhs.firstName;
+    return lhs.lastName < rhs.lastName;
+}
+
+QString MemberSearchIndex::normalize(const QString &text) {
+    QString folded;
+    const auto decomposed = text.normalized(QString::NormalizationForm_KD);
+    folded.reserve(decomposed.size());
+    for (auto c : decomposed) {
+        if (c.category() != QChar::Mark_NonSpacing) folded.append(c);
+    }
+    return folded.toCaseFolded().simplified();
+}
+
+void MemberSearchIndex::setMembers(QVector<Member> members) {
+    members_ = std::move(members);
+    std::stable_sort(members_.begin(), members_.end(), &nameOrder);
+
+    keys_.clear();
+    keys_.reserve(members_.size() * 3);
+    for (const auto &m : members_) {
+        addKeys(m);
+    }
+    std::sort(keys_.begin(), keys_.end());
+}
+
+void MemberSearchIndex::addKeys(const Member &member) {
+    const auto firstName = normalize(member.firstName);
+    const auto lastName = normalize(member.lastName);
+
+    // Every word of a name is a key of its own, so "ann" finds "Mary Ann"
+    for (const auto &name : {firstName, lastName}) {
+        for (const auto &word : name.split(QLatin1Char(' '), Qt::SkipEmptyParts)) {
+            keys_.push_back({word, member.id});
+        }
+    }
+    keys_.push_back({firstName.left(1) + lastName.left(1), member.id});
+}
+
+void MemberSearchIndex::upsert(const Member &member) {
+    remove(member.id);
+
+    members_.insert(std::upper_bound(members_.begin(), members_.end(), member, &nameOrder), member);
+
+    const auto numKeys = keys_.size();
+    addKeys(member);
+    std::sort(keys_.begin() + numKeys, keys_.end());
+    std::inplace_merge(keys_.begin(), keys_.begin() + numKeys, keys_.end());
+}
+
+void MemberSearchIndex::remove(MemberId memberId) {
+    members_.erase(std::remove_if(members_.begin(), members_.end(), [=](const Member &m) {
+        return m.id == memberId;
+    }), members_.end());
+    keys_.erase(std::remove_if(keys_.begin(), keys_.end(), [=](const Key &k) {
+        return k.memberId == memberId;
+    }), keys_.end());
+}
+
+QVector<Member> MemberSearchIndex::search(const QString &needle) const {
+    const auto terms = normalize(needle).split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    if (terms.isEmpty()) return members_;
+
+    std::optional<QSet<MemberId>> matches;
+    for (const auto &term : terms) {
+        QSet<MemberId> termMatches;
+        for (auto key = std::lower_bound(keys_.begin(), keys_.end(), Key{term, 0});
+             key != keys_.end() && key->text.startsWith(term); ++key) {
+            termMatches.insert(key->memberId);
+        }
+
+        if (matches) {
+            matches->intersect(termMatches);
+        } else {
+            matches = std::move(termMatches);
+        }
+        if (matches->isEmpty()) return {};
+    }
+
+    QVector<Member> result;
+    for (const auto &m : members_) {
+        if (matches->contains(m.id)) result.push_back(m);
+    }
+    return result;
+}
@@ -0,0 +1,51 @@
+#ifndef GAMEMATCHER_MEMBERSEARCHINDEX_H
+#define GAMEMATCHER_MEMBERSEARCHINDEX_H
+
+#include "models.h"
+
+#include <QString>
+#include <QVector>
+
+// Prefix search over a member list kept in memory, for filtering as fast as someone can type.
+// Each member is keyed by the words of their first and last names and their initials, case and accent folded, in
+// one sorted array: a search term is a binary search plus a walk over the keys it prefixes.
+// Every word of a search has to prefix one of the member's keys.
+class MemberSearchIndex {
+public:
+    MemberSearchIndex() = default;
+
+    explicit MemberSearchIndex(QVector<Member> members) {
+        setMembers(std::move(members));
+    }
+
+    void setMembers(QVector<Member> members);
+
+    // Adds or replaces a member, keeping the name order
+    void upsert(const Member &member);
+
+    void remove(MemberId memberId);
+
+    const QVector<Member> &members() const { return members_; }
+
+    // Matching members in name order, all of them for a blank needle
+    QVector<Member> search(const QString &needle) const;
+
+    static QString normalize(const QString &text);
+
+private:
+    struct Key {
+        QString text;
+        MemberId memberId;
+
+        bool operator<(const Key &rhs) const {
+            return text < rhs.text || (text == rhs.text && memberId < rhs.memberId);
+        }
+    };
+
+    void addKeys(const Member &member);
+
+    QVector<Member> members_;
+    QVector<Key> keys_;
+};
+
+#endif //GAMEMATCHER_MEMBERSEARCHINDEX_H
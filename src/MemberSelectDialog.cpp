@@ -9,31 +9,90 @@
 #include "EditMemberDialog.h"
 #include "MemberMenu.h"
 #include "MemberPainter.h"
+#include "MemberSearchIndex.h"
 
+#include <algorithm>
+#include <functional>
 #include <QPushButton>
-#include <QTimer>
 #include <QListWidgetItem>
+#include <QSet>
 
 struct MemberSelectDialog::Impl {
     MemberSearchFilter filter;
     ClubRepository *repo;
-    QTimer *filterDebounceTimer;
     bool closeWhenSelected;
     Ui::MemberSelectDialog ui;
+
+    // Everyone the filter lets through, the text box only narrows this down
+    MemberSearchIndex index;
+
+    bool showsSession(SessionId sessionId) const {
+        return sessionIdFrom(filter) == sessionId;
+    }
+
+    QListWidgetItem *itemOf(MemberId memberId) const {
+        for (int i = 0, size = ui.memberList->count(); i < size; i++) {
+            auto item = ui.memberList->item(i);
+            if (item->data(Qt::UserRole).value<Member>().id == memberId) return item;
+        }
+        return nullptr;
+    }
+
+    // Patches the row of a member in place, false if they aren't listed
+    bool patchMember(MemberId memberId, const std::function<void(Member &)> &change) {
+        auto item = itemOf(memberId);
+        if (!item) return false;
+
+        auto member = item->data(Qt::UserRole).value<Member>();
+        change(member);
+        item->setData(Qt::UserRole, QVariant::fromValue(member));
+        item->setForeground(MemberPainter::colorForMember(member));
+        index.upsert(member);
+        return true;
+    }
 };
 
 MemberSelectDialog::MemberSelectDialog(MemberSearchFilter filter, bool showRegister, bool closeWhenSelected, ClubRepository *repo, QWidget *parent)
-        : QDialog(parent), d(new Impl{filter, repo, new QTimer(this), closeWhenSelected}) {
+        : QDialog(parent), d(new Impl{filter, repo, closeWhenSelected}) {
     d->ui.setupUi(this);
-    d->filterDebounceTimer->setSingleShot(true);
-    d->filterDebounceTimer->setInterval(500);
 
     d->ui.registerButton->setVisible(showRegister);
 
-    connect(d->repo, &ClubRepository::sessionChanged, this, &MemberSelectDialog::reload, Qt::QueuedConnection);
-    connect(d->repo, &ClubRepository::memberChanged, this, &MemberSelectDialog::reload, Qt::QueuedConnection);
-    connect(d->filterDebounceTimer, &QTimer::timeout, this, &MemberSelectDialog::reload);
-    connect(d->ui.filterEdit, &QLineEdit::textChanged, d->filterDebounceTimer, qOverload<>(&QTimer::start));
+    // Check ins and flag changes are patched in as they happen, anything else waits for the batch
+    connect(d->repo, &ClubRepository::playerCheckedIn, this, [=](SessionId sessionId, const Member &member) {
+        if (d->showsSession(sessionId) && std::get_if<NonCheckedIn>(&d->filter)) {
+            d->index.remove(member.id);
+            delete d->itemOf(member.id);
+            validateForm();
+        }
+    }, Qt::QueuedConnection);
+    connect(d->repo, &ClubRepository::paidChanged, this, [=](SessionId sessionId, MemberId memberId, bool paid) {
+        if (d->showsSession(sessionId)) d->patchMember(memberId, [=](Member &m) { m.paid = paid; });
+    }, Qt::QueuedConnection);
+    connect(d->repo, &ClubRepository::pauseChanged, this, [=](SessionId sessionId, MemberId memberId, bool paused) {
+        if (d->showsSession(sessionId)) {
+            d->patchMember(memberId, [=](Member &m) {
+                if (m.status != Member::CheckedOut) m.status = paused ? Member::CheckedInPaused : Member::CheckedIn;
+            });
+        }
+    }, Qt::QueuedConnection);
+    connect(d->repo, &ClubRepository::changesFlushed, this, [=](const ChangeSet &changes) {
+        if (changes.members) {
+            reload();
+            return;
+        }
+
+        auto sessionId = sessionIdFrom(d->filter);
+        if (!sessionId) return;
+
+        // Checked out players still count as checked in to the session, so a check in list only grows
+        auto checkedIn = std::get_if<CheckedIn>(&d->filter);
+        if ((changes.sessions.contains(*sessionId) && !std::get_if<NonCheckedIn>(&d->filter)) ||
+            (changes.playerFlags.contains(*sessionId) && checkedIn && checkedIn->paused)) {
+            reload();
+        }
+    });
+    connect(d->ui.filterEdit, &QLineEdit::textChanged, this, &MemberSelectDialog::applyFilter);
 
     connect(d->ui.memberList, &QListWidget::itemSelectionChanged, this, &MemberSelectDialog::validateForm);
     connect(d->ui.memberList, &QWidget::customContextMenuRequested, [=](auto pt) {
@@ -66,24 +125,45 @@ MemberSelectDialog::~MemberSelectDialog() {
 }
 
 void MemberSelectDialog::reload() {
-    QVector<Member> members;
-
-    if (auto needle = d->ui.filterEdit->text().trimmed(); !needle.isEmpty()) {
-        members = d->repo->findMember(d->filter, needle);
-    } else {
-        members = d->repo->getMembers(d->filter);
-    }
+    d->index.setMembers(d->repo->getMembers(d->filter));
 
     d->ui.memberList->clear();
     QFont font;
     font.setPointSize(20.0);
     font.setBold(true);
-    for (const auto &member : members) {
+    for (const auto &member : d->index.members()) {
         auto item = new QListWidgetItem(member.fullName(), d->ui.memberList);
         item->setFont(font);
         item->setData(Qt::UserRole, QVariant::fromValue(member));
         item->setForeground(MemberPainter::colorForMember(member));
     }
+
+    applyFilter();
+}
+
+// Phone numbers and emails aren't in the in-memory index, the repository's full text search covers those
+static bool looksLikeContact(const QString &needle) {
+    return std::any_of(needle.begin(), needle.end(), [](QChar c) {
+        return c.isDigit() || c == QLatin1Char('@');
+    });
+}
+
+void MemberSelectDialog::applyFilter() {
+    const auto needle = d->ui.filterEdit->text();
+
+    QSet<MemberId> shown;
+    for (const auto &member : looksLikeContact(needle) ? d->repo->findMember(d->filter, needle)
+                                                       : d->index.search(needle)) {
+        shown.insert(member.id);
+    }
+
+    for (int i = 0, size = d->ui.memberList->count(); i < size; i++) {
+        auto item = d->ui.memberList->item(i);
+        const auto hidden = !shown.contains(item->data(Qt::UserRole).value<Member>().id);
+        item->setHidden(hidden);
+        if (hidden) item->setSelected(false);
+    }
+    validateForm();
 }
 
 void MemberSelectDialog::validateForm() {
@@ -42,6 +42,7 @@ signals:
 
 private slots:
     void reload();
+    void applyFilter();
     void validateForm();
 
 private:
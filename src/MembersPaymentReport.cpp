@@ -7,6 +7,7 @@
 #include "ClubRepository.h"
 
 #include <optional>
+#include <QFutureWatcher>
 #include <QHash>
 #include <QVector>
 #include <QMap>
@@ -18,12 +19,34 @@ struct MembersPaymentReport::Impl {
         QHash<MemberId, bool> history;
     };
 
+    struct PaymentData {
+        QMap<MemberId, QString> members;
+        QHash<SessionId, SessionPaymentHistory> paymentHistory;
+    };
+
     ClubRepository * const repo;
     QSet<SessionId> sessions;
     bool dataDirty = true;
+
+    // Built straight from the records of `sessions` as they are read, off the GUI thread
+    QFutureWatcher<PaymentData> loadingData;
     QMap<MemberId, QString> members;
     QHash<SessionId, SessionPaymentHistory> paymentHistory;
 
+    static PaymentData readData(const ClubRepository &repo, const QSet<SessionId> &sessions) {
+        PaymentData data;
+        repo.forEachPaymentRecord(sessions, [&](const PaymentRecord &record) {
+            auto &session = data.paymentHistory[record.sessionId];
+            session.startTime.setSecsSinceEpoch(record.sessionStartTime);
+            session.history[record.memberId] = record.paid;
+            if (!data.members.contains(record.memberId)) {
+                data.members[record.memberId] = tr("%1 %2").arg(record.memberFirstName, record.memberLastName);
+            }
+            return true;
+        });
+        return data;
+    }
+
     void loadDataIfNecessary() {
         if (!dataDirty) return;
 
@@ -32,17 +55,15 @@ struct MembersPaymentReport::Impl {
         paymentHistory.clear();
         if (sessions.isEmpty()) return;
 
-        for (const auto &record : repo->getPaymentRecords(sessions)) {
-            paymentHistory[record.sessionId].startTime.setSecsSinceEpoch(record.sessionStartTime);
-            paymentHistory[record.sessionId].history[record.memberId] = record.paid;
-            if (!members.contains(record.memberId)) {
-                members[record.memberId] = tr("%1 %2").arg(record.memberFirstName, record.memberLastName);
-            }
-        }
+        auto data = loadingData.future().result();
+        members = std::move(data.members);
+        paymentHistory = std::move(data.paymentHistory);
     }
 };
 
-MembersPaymentReport::MembersPaymentReport(ClubRepository *repo, QObject *parent) : BaseReport(repo, parent), d(new Impl{ repo }) {}
+MembersPaymentReport::MembersPaymentReport(ClubRepository *repo, QObject *parent) : BaseReport(repo, parent), d(new Impl{ repo }) {
+    connect(&d->loadingData, &QFutureWatcherBase::finished, this, &BaseReport::dataChanged);
+}
 
 MembersPaymentReport::~MembersPaymentReport() = default;
 
@@ -50,7 +71,15 @@ void MembersPaymentReport::setSessions(const QSet<SessionId> &sessions) {
     if (d->sessions != sessions) {
         d->sessions = sessions;
         d->dataDirty = true;
-        emit this->dataChanged();
+
+        // Reports the change once the records are in, a view asking before then waits for them
+        if (sessions.isEmpty()) {
+            emit this->dataChanged();
+        } else {
+            d->loadingData.setFuture(d->repo->readAsync([sessions](const ClubRepository &repo) {
+                return Impl::readData(repo, sessions);
+            }));
+        }
     }
 }
 
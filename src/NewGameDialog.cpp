@@ -13,11 +13,14 @@
 #include "LastSelectedCourts.h"
 
 #include "GameMatcher.h"
+#include "CoPlayHistory.h"
+#include "SchedulePlanner.h"
 
 #include <QEvent>
 #include <QMenu>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QSet>
 #include <QProgressDialog>
 #include <QCheckBox>
 #include <QFutureWatcher>
@@ -26,7 +29,6 @@
 static const auto dataRoleMember = Qt::UserRole;
 static const auto propCourtId = "courtId";
 
-static const SettingKey skLastSelectedCourts = QStringLiteral("last_selected_courts");
 static const SettingKey skLastGameDurationSeconds = QStringLiteral("last_game_duration_seconds");
 
 static const auto defaultGameDurationSeconds = 15 * 60;
@@ -35,6 +37,8 @@ static const auto minGameDurationSeconds = 30;
 struct NewGameDialog::Impl {
     SessionData const session;
     ClubRepository *const repo;
+    SchedulePlanner *const planner;
+    std::optional<RotationTracker> rotation;
     Ui::NewGameDialog ui;
 
     int countEligiblePlayer() const {
@@ -83,7 +87,9 @@ NewGameDialog::NewGameDialog(Impl *d, QWidget *parent)
     connect(d->ui.minuteBox, qOverload<int>(&QSpinBox::valueChanged), this, &NewGameDialog::validateForm);
     connect(d->ui.secondBox, qOverload<int>(&QSpinBox::valueChanged), this, &NewGameDialog::validateForm);
 
-    connect(d->repo, &ClubRepository::sessionChanged, this, &NewGameDialog::refresh);
+    connect(d->repo, &ClubRepository::changesFlushed, this, [=](const ChangeSet &changes) {
+        if (changes.affects(d->session.session.id)) refresh();
+    });
 
     connect(d->ui.playerList, &QListWidget::itemDoubleClicked, [=](QListWidgetItem *item) {
         auto member = item->data(dataRoleMember).value<Member>();
@@ -192,6 +198,41 @@ void NewGameDialog::accept() {
         }
     }
 
+    LastSelectedCourt lastSelected = {d->session.session.id};
+    for (auto courtId : courtIds) {
+        lastSelected.selectedCourts.insert(courtId);
+    }
+
+    if (!d->repo->saveSetting(skLastSelectedCourts, lastSelected.toString())) {
+        qWarning() << "Unable to save last selected courts";
+    }
+
+    if (!d->repo->saveSetting(skLastGameDurationSeconds, QVariant::fromValue(d->readDurationSeconds()))) {
+        qWarning() << "Unable to save last game duration seconds";
+    }
+
+    QVector<Member> players;
+    for (int i = 0, size = d->ui.playerList->count(); i < size; i++) {
+        auto member = d->ui.playerList->item(i)->data(dataRoleMember).value<Member>();
+        if (member.status == Member::CheckedIn) {
+            players.push_back(member);
+        }
+    }
+
+    if (d->planner) {
+        auto lastGame = d->repo->getLastGameInfo(d->session.session.id);
+        auto round = d->planner->nextRound(lastGame ? std::optional<GameId>(lastGame->id) : std::nullopt,
+                                           players, courtIds);
+        if (round) {
+            if (auto gameId = d->repo->createGame(d->session.session.id, *round, d->readDurationSeconds())) {
+                d->planner->roundStarted(*gameId);
+                emit this->newGameMade();
+                QDialog::accept();
+                return;
+            }
+        }
+    }
+
     auto progressDialog = new QProgressDialog(tr("Calculating..."), tr("Cancel"), 0, 0, this);
     progressDialog->open();
 
@@ -208,45 +249,46 @@ void NewGameDialog::accept() {
         resultWatcher->deleteLater();
     });
 
-    QVector<Member> players;
-    for (int i = 0, size = d->ui.playerList->count(); i < size; i++) {
-        auto member = d->ui.playerList->item(i)->data(dataRoleMember).value<Member>();
-        if (member.status == Member::CheckedIn) {
-            players.push_back(member);
-        }
-    }
-
     auto pastAllocations = d->repo->getPastAllocations(d->session.session.id);
+    auto coPlayHistory = d->repo->getCoPlayHistory(d->session.session.id);
     unsigned numPlayersPerCourt = d->session.session.numPlayersPerCourt;
 
+    QSet<GameId> pastGames;
+    for (const auto &allocation : pastAllocations) {
+        pastGames.insert(allocation.gameId);
+    }
+
+    // The session's rotation only needs the players picked here made its active ones
+    std::optional<RotationTracker> rotation;
+    if (d->rotation && d->rotation->numGames() == pastGames.size()) {
+        QVector<BasePlayerInfo> activePlayers;
+        for (const auto &player : players) {
+            activePlayers.push_back(BasePlayerInfo(player));
+        }
+        rotation = d->rotation;
+        rotation->setActivePlayers(activePlayers);
+    }
+
     resultWatcher->setFuture(
             QtConcurrent::run([pastAllocations = std::move(pastAllocations),
+                                      coPlayHistory = std::move(coPlayHistory),
+                                      rotation = std::move(rotation),
                                       allPlayers = std::move(players),
                                       courtIds,
                                       numPlayersPerCourt] {
                 return GameMatcher::match(pastAllocations,
                                           allPlayers, courtIds, numPlayersPerCourt,
-                                          QDateTime::currentMSecsSinceEpoch());
+                                          QDateTime::currentMSecsSinceEpoch(),
+                                          &coPlayHistory,
+                                          rotation ? &*rotation : nullptr);
             })
     );
-
-    LastSelectedCourt lastSelected = {d->session.session.id};
-    for (auto courtId : courtIds) {
-        lastSelected.selectedCourts.insert(courtId);
-    }
-
-    if (!d->repo->saveSetting(skLastSelectedCourts, lastSelected.toString())) {
-        qWarning() << "Unable to save last selected courts";
-    }
-
-    if (!d->repo->saveSetting(skLastGameDurationSeconds, QVariant::fromValue(d->readDurationSeconds()))) {
-        qWarning() << "Unable to save last game duration seconds";
-    }
 }
 
-NewGameDialog *NewGameDialog::create(SessionId id, ClubRepository *repo, QWidget *parent) {
+NewGameDialog *NewGameDialog::create(SessionId id, ClubRepository *repo, QWidget *parent, SchedulePlanner *planner,
+                                     std::optional<RotationTracker> rotation) {
     if (auto session = repo->getSession(id)) {
-        return new NewGameDialog(new Impl{*session, repo}, parent);
+        return new NewGameDialog(new Impl{*session, repo, planner, std::move(rotation)}, parent);
     }
 
     return nullptr;
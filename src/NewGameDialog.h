@@ -9,14 +9,21 @@
 #include <QDialog>
 
 #include "models.h"
+#include "RotationTracker.h"
+
+#include <optional>
 
 class QListWidgetItem;
 class ClubRepository;
+class SchedulePlanner;
 
 class NewGameDialog : public QDialog {
     Q_OBJECT
 public:
-    static NewGameDialog *create(SessionId, ClubRepository *, QWidget *parent);
+    // The session's rotation, when given, saves the matcher replaying the session. It's left out if games
+    // have been made or withdrawn since.
+    static NewGameDialog *create(SessionId, ClubRepository *, QWidget *parent, SchedulePlanner *planner = nullptr,
+                                 std::optional<RotationTracker> rotation = std::nullopt);
 
     ~NewGameDialog() override;
 
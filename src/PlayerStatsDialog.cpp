@@ -39,7 +39,14 @@ void PlayerStatsDialog::changeEvent(QEvent *evt) {
 }
 
 void PlayerStatsDialog::reload() {
-    auto stats = d->repo->getMemberGameStats(d->memberId, d->sessionId);
+    d->repo->readAsync([memberId = d->memberId, sessionId = d->sessionId](const ClubRepository &repo) {
+        return repo.getMemberGameStats(memberId, sessionId);
+    }, this, [this](const MemberGameStats &stats) {
+        showStats(stats);
+    });
+}
+
+void PlayerStatsDialog::showStats(const MemberGameStats &stats) {
     d->ui.numGamesValue->setText(QString::number(stats.pastGames.size()));
     d->ui.numGamesOffValue->setText(QString::number(stats.numGamesOff));
 
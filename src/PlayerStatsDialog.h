@@ -10,6 +10,7 @@
 #include "models.h"
 
 class ClubRepository;
+struct MemberGameStats;
 
 class PlayerStatsDialog : public QDialog {
 Q_OBJECT
@@ -23,6 +24,9 @@ public:
 private slots:
     void reload();
 
+private:
+    void showStats(const MemberGameStats &);
+
 private:
     struct Impl;
     Impl *d;
@@ -13,12 +13,47 @@
 #include <QEvent>
 #include <QMenu>
 #include <map>
-#include <set>
+#include <vector>
 
 struct PlayerTablePage::Impl {
     SessionId sessionId = 0;
     ClubRepository *repo = nullptr;
     Ui::PlayerTablePage ui;
+
+    QVector<QMetaObject::Connection> repoConnections;
+
+    // Members in the table, so changes to anyone else don't reload it
+    QSet<MemberId> shownMemberIds;
+
+    // Allocations loaded so far, only the games made since are fetched on reload. Withdrawing a game or
+    // changing one before the last starts it over.
+    QHash<MemberId, QHash<GameId, CourtId>> allocationMap;
+    std::vector<GameId> gameIds;
+
+    void resetAllocations() {
+        allocationMap.clear();
+        gameIds.clear();
+    }
+
+    void updateAllocations() {
+        // The last game can still be repaired, so it's always read again
+        if (!gameIds.empty()) {
+            for (auto &memberGames : allocationMap) {
+                memberGames.remove(gameIds.back());
+            }
+            gameIds.pop_back();
+        }
+
+        std::optional<GameId> lastGameId;
+        if (!gameIds.empty()) lastGameId = gameIds.back();
+
+        for (const auto &allocation : repo->getAllocationsSince(sessionId, lastGameId)) {
+            if (gameIds.empty() || gameIds.back() != allocation.gameId) {
+                gameIds.push_back(allocation.gameId);
+            }
+            allocationMap[allocation.memberId][allocation.gameId] = allocation.courtId;
+        }
+    }
 };
 
 PlayerTablePage::PlayerTablePage(QWidget *parent)
@@ -44,18 +79,18 @@ void PlayerTablePage::reload() {
     auto members = d->repo->getMembers(AllSession{d->sessionId});
     formatMemberDisplayNames(members);
 
+    d->shownMemberIds.clear();
+    for (const auto &member : members) {
+        d->shownMemberIds.insert(member.id);
+    }
+
     auto courtById = associateBy<QHash<CourtId, Court>>(
             d->repo->getSession(d->sessionId)->courts,
             [](auto &c) {
                 return c.id;
             });
-    QHash<MemberId, QHash<GameId, CourtId>> allocationMap;
-    std::set<GameId> gameIdSet;
-    for (const auto &allocation : d->repo->getPastAllocations(d->sessionId)) {
-        gameIdSet.insert(allocation.gameId);
-        allocationMap[allocation.memberId][allocation.gameId] = allocation.courtId;
-    }
-    std::vector<GameId> gameIds(gameIdSet.begin(), gameIdSet.end());
+    d->updateAllocations();
+    const auto &gameIds = d->gameIds;
 
     std::sort(members.begin(), members.end(), [](const Member &a, const Member &b) {
         return a.fullName().localeAwareCompare(b.fullName()) < 0;
@@ -103,7 +138,7 @@ void PlayerTablePage::reload() {
             d->ui.table->setItem(row, 0, checkMark);
         }
 
-        auto &memberGames = allocationMap[member.id];
+        const auto memberGames = d->allocationMap.value(member.id);
         for (int j = 0; j < gameIds.size(); j++) {
             auto gameId = gameIds[j];
                 QTableWidgetItem *courtItem;
@@ -134,12 +169,42 @@ void PlayerTablePage::on_table_customContextMenuRequested(const QPoint &pt) {
 
 void PlayerTablePage::load(SessionId id, ClubRepository *repo) {
     if (d->repo != repo) {
-        if (d->repo) disconnect(d->repo, &ClubRepository::sessionChanged, this, &PlayerTablePage::reload);
+        for (const auto &connection : d->repoConnections) {
+            disconnect(connection);
+        }
+        d->repoConnections.clear();
+
         if (repo) {
-            connect(repo, &ClubRepository::sessionChanged, this, &PlayerTablePage::reload);
+            d->repoConnections.push_back(connect(repo, &ClubRepository::changesFlushed, this,
+                                                 [=](const ChangeSet &changes) {
+                if (changes.sessions.contains(d->sessionId) || changes.playerFlags.contains(d->sessionId) ||
+                    changes.affectsAnyMember(d->shownMemberIds)) {
+                    reload();
+                }
+            }));
+            d->repoConnections.push_back(connect(repo, &ClubRepository::gameWithdrawn, this, [=](SessionId sessionId) {
+                if (sessionId == d->sessionId) d->resetAllocations();
+            }));
+            d->repoConnections.push_back(connect(repo, &ClubRepository::playerCheckedIn, this,
+                                                 [=](SessionId sessionId, const Member &member) {
+                // Checking in again replaces the player along with their allocations
+                if (sessionId == d->sessionId && d->allocationMap.contains(member.id)) d->resetAllocations();
+            }));
+            d->repoConnections.push_back(connect(repo, &ClubRepository::gameChanged, this,
+                                                 [=](SessionId sessionId, GameId gameId) {
+                if (sessionId == d->sessionId && !d->gameIds.empty() && gameId != d->gameIds.back()) {
+                    d->resetAllocations();
+                }
+            }));
         }
         d->repo = repo;
+        d->resetAllocations();
     }
-    d->sessionId = id;
+
+    if (d->sessionId != id) {
+        d->sessionId = id;
+        d->resetAllocations();
+    }
+
     reload();
 }
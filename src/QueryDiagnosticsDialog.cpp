@@ -0,0 +1,111 @@
+#include "QueryDiagnosticsDialog.h"
+#include "ui_QueryDiagnosticsDialog.h"
+
+#include "ClubRepository.h"
+#include "QueryProfiler.h"
+
+#include <QDateTime>
+#include <QEvent>
+
+static const int numTopQueries = 50;
+
+static QTableWidgetItem *numberItem(const QVariant &value) {
+    auto item = new QTableWidgetItem();
+    item->setData(Qt::DisplayRole, value);
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+static QTableWidgetItem *sqlItem(const QString &sql, const QStringList &plan = QStringList()) {
+    auto item = new QTableWidgetItem(sql.simplified());
+    item->setToolTip(plan.isEmpty() ? sql : sql + QStringLiteral("\n\n") + plan.join(QLatin1Char('\n')));
+    return item;
+}
+
+struct QueryDiagnosticsDialog::Impl {
+    ClubRepository * const repo;
+    Ui::QueryDiagnosticsDialog ui;
+};
+
+QueryDiagnosticsDialog::QueryDiagnosticsDialog(ClubRepository *repo, QWidget *parent)
+        : QDialog(parent), d(new Impl{repo}) {
+    d->ui.setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    auto &profiler = QueryProfiler::instance();
+    d->ui.slowThresholdSpinBox->setValue(profiler.slowThresholdMs());
+    d->ui.explainCheckBox->setChecked(profiler.explainSlowQueries());
+#ifdef NDEBUG
+    d->ui.explainCheckBox->setEnabled(false);
+#endif
+
+    connect(d->ui.slowThresholdSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), [](int value) {
+        QueryProfiler::instance().setSlowThresholdMs(value);
+    });
+    connect(d->ui.explainCheckBox, &QCheckBox::toggled, [](bool checked) {
+        QueryProfiler::instance().setExplainSlowQueries(checked);
+    });
+    connect(d->ui.refreshButton, &QPushButton::clicked, this, &QueryDiagnosticsDialog::reload);
+    connect(d->ui.clearButton, &QPushButton::clicked, [=] {
+        QueryProfiler::instance().clear();
+        reload();
+    });
+    connect(d->ui.buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    reload();
+}
+
+QueryDiagnosticsDialog::~QueryDiagnosticsDialog() {
+    delete d;
+}
+
+void QueryDiagnosticsDialog::reload() {
+    auto &profiler = QueryProfiler::instance();
+
+    if (d->repo) {
+        auto cache = d->repo->getStatementCacheStats();
+        auto changes = d->repo->getChangeNotificationStats();
+        d->ui.cacheStatsLabel->setText(
+                tr("Statement cache: %1 hits, %2 misses, %3 statements. Change notifications: %4 changes in %5 batches.")
+                        .arg(cache.hits).arg(cache.misses).arg(cache.numStatements)
+                        .arg(changes.numChanges).arg(changes.numFlushes));
+    }
+
+    auto topQueries = profiler.topQueries(numTopQueries);
+    auto table = d->ui.topQueriesTable;
+    table->setSortingEnabled(false);
+    table->setRowCount(topQueries.size());
+    for (int row = 0, size = topQueries.size(); row < size; row++) {
+        const auto &q = topQueries[row];
+        table->setItem(row, 0, numberItem(q.totalUs / 1000.0));
+        table->setItem(row, 1, numberItem(q.numCalls));
+        table->setItem(row, 2, numberItem(q.totalUs / 1000.0 / q.numCalls));
+        table->setItem(row, 3, numberItem(q.maxUs / 1000.0));
+        table->setItem(row, 4, numberItem(q.numRows));
+        table->setItem(row, 5, sqlItem(q.sql));
+    }
+    table->setSortingEnabled(true);
+    table->resizeColumnsToContents();
+
+    auto slowQueries = profiler.slowSamples();
+    table = d->ui.slowQueriesTable;
+    table->setRowCount(slowQueries.size());
+    for (int row = 0, size = slowQueries.size(); row < size; row++) {
+        // Latest first
+        const auto &q = slowQueries[size - 1 - row];
+        table->setItem(row, 0, new QTableWidgetItem(
+                QDateTime::fromMSecsSinceEpoch(q.timestamp).toString(QStringLiteral("HH:mm:ss.zzz"))));
+        table->setItem(row, 1, numberItem(q.elapsedUs / 1000.0));
+        table->setItem(row, 2, numberItem(q.numParams));
+        table->setItem(row, 3, numberItem(q.numRows));
+        table->setItem(row, 4, sqlItem(q.sql, q.plan));
+    }
+    table->resizeColumnsToContents();
+}
+
+void QueryDiagnosticsDialog::changeEvent(QEvent *evt) {
+    QDialog::changeEvent(evt);
+    if (evt->type() == QEvent::LanguageChange) {
+        d->ui.retranslateUi(this);
+    }
+}
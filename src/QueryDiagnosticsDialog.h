@@ -0,0 +1,28 @@
+#ifndef GAMEMATCHER_QUERYDIAGNOSTICSDIALOG_H
+#define GAMEMATCHER_QUERYDIAGNOSTICSDIALOG_H
+
+
+#include <QDialog>
+
+class ClubRepository;
+
+// Where the time in the database goes, from the QueryProfiler. Not in any menu, the club page opens it with a shortcut.
+class QueryDiagnosticsDialog : public QDialog {
+Q_OBJECT
+public:
+    explicit QueryDiagnosticsDialog(ClubRepository *, QWidget *parent = nullptr);
+
+    ~QueryDiagnosticsDialog() override;
+
+    void changeEvent(QEvent *) override;
+
+private slots:
+    void reload();
+
+private:
+    struct Impl;
+    Impl *d;
+};
+
+
+#endif //GAMEMATCHER_QUERYDIAGNOSTICSDIALOG_H
@@ -0,0 +1,148 @@
+#include "QueryProfiler.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcSlowQuery, "gamematcher.sql.slow")
+
+// Whether a scope is timing a query on this thread already
+static thread_local bool scopeRunning = false;
+
+QueryProfiler &QueryProfiler::instance() {
+    static QueryProfiler profiler;
+    return profiler;
+}
+
+void QueryProfiler::setEnabled(bool enabled) {
+    enabled_ = enabled;
+}
+
+bool QueryProfiler::isEnabled() const {
+    return enabled_;
+}
+
+void QueryProfiler::setSlowThresholdMs(int ms) {
+    slowThresholdMs_ = std::max(0, ms);
+}
+
+int QueryProfiler::slowThresholdMs() const {
+    return slowThresholdMs_;
+}
+
+void QueryProfiler::setExplainSlowQueries(bool explain) {
+#ifdef NDEBUG
+    if (explain) qWarning() << "Query plans are only captured in debug builds";
+#else
+    explainSlowQueries_ = explain;
+#endif
+}
+
+bool QueryProfiler::explainSlowQueries() const {
+    return explainSlowQueries_;
+}
+
+void QueryProfiler::record(Sample sample) {
+    const bool slow = sample.elapsedUs >= slowThresholdMs_ * 1000LL;
+    if (slow) {
+        qCWarning(lcSlowQuery).noquote().nospace()
+                << "Slow query took " << sample.elapsedUs / 1000.0 << "ms, " << sample.numParams << " params, "
+                << sample.numRows << " rows: " << sample.sql;
+        for (const auto &step : sample.plan) {
+            qCWarning(lcSlowQuery).noquote() << "    " << step;
+        }
+    }
+
+    QMutexLocker locker(&lock_);
+    auto &totals = totals_[sample.sql];
+    if (totals.numCalls++ == 0) totals.sql = sample.sql;
+    totals.totalUs += sample.elapsedUs;
+    totals.maxUs = std::max(totals.maxUs, sample.elapsedUs);
+    totals.numRows += std::max(0, sample.numRows);
+
+    if (slow) {
+        if (slowSamples_.size() >= slowCapacity) slowSamples_.removeFirst();
+        slowSamples_.push_back(sample);
+    }
+
+    if (samples_.size() < capacity) {
+        samples_.push_back(std::move(sample));
+    } else {
+        samples_[nextSample_] = std::move(sample);
+    }
+    nextSample_ = (nextSample_ + 1) % capacity;
+}
+
+void QueryProfiler::clear() {
+    QMutexLocker locker(&lock_);
+    samples_.clear();
+    slowSamples_.clear();
+    nextSample_ = 0;
+    totals_.clear();
+}
+
+QVector<QueryProfiler::Sample> QueryProfiler::recentSamples() const {
+    QMutexLocker locker(&lock_);
+    if (samples_.size() < capacity) return samples_;
+
+    QVector<Sample> result;
+    result.reserve(capacity);
+    result.append(samples_.mid(nextSample_));
+    result.append(samples_.mid(0, nextSample_));
+    return result;
+}
+
+QVector<QueryProfiler::Sample> QueryProfiler::slowSamples() const {
+    QMutexLocker locker(&lock_);
+    return slowSamples_;
+}
+
+QVector<QueryProfiler::Totals> QueryProfiler::topQueries(int limit) const {
+    QVector<Totals> result;
+    {
+        QMutexLocker locker(&lock_);
+        result.reserve(totals_.size());
+        for (const auto &totals : totals_) {
+            result.push_back(totals);
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const Totals &lhs, const Totals &rhs) {
+        return lhs.totalUs > rhs.totalUs;
+    });
+    if (limit >= 0 && result.size() > limit) result.resize(limit);
+    return result;
+}
+
+QueryProfiler::Scope::Scope(const QString &sql, int numParams, std::function<QStringList()> explain)
+        : sql_(sql), numParams_(numParams), explain_(std::move(explain)),
+          active_(!scopeRunning && QueryProfiler::instance().isEnabled()) {
+    if (active_) {
+        scopeRunning = true;
+        timer_.start();
+    }
+}
+
+QueryProfiler::Scope::~Scope() {
+    if (!active_) return;
+
+    auto &profiler = QueryProfiler::instance();
+
+    Sample sample;
+    sample.sql = sql_;
+    sample.numParams = numParams_;
+    sample.elapsedUs = timer_.nsecsElapsed() / 1000;
+    sample.numRows = numRows_;
+    sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+
+#ifndef NDEBUG
+    // Still counted as running, so the queries explaining this one aren't recorded
+    if (explain_ && profiler.explainSlowQueries() && sample.elapsedUs >= profiler.slowThresholdMs() * 1000LL) {
+        sample.plan = explain_();
+    }
+#endif
+
+    scopeRunning = false;
+    profiler.record(std::move(sample));
+}
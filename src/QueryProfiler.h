@@ -0,0 +1,104 @@
+#ifndef GAMEMATCHER_QUERYPROFILER_H
+#define GAMEMATCHER_QUERYPROFILER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+
+#include <atomic>
+#include <functional>
+
+Q_DECLARE_LOGGING_CATEGORY(lcSlowQuery)
+
+// Timings of the SQL run by every repository in the process, readers on other threads included.
+// The latest queries are kept in a ring buffer and the totals per SQL text for as long as the app runs.
+// Queries slower than the threshold also go to the slow query log.
+class QueryProfiler {
+public:
+    struct Sample {
+        QString sql;
+        int numParams = 0;
+        qint64 elapsedUs = 0;
+        int numRows = -1; // -1 when the rows are read by the caller
+        qint64 timestamp = 0; // ms since epoch
+
+        // Only filled for slow queries in debug builds, when asked for with setExplainSlowQueries
+        QStringList plan;
+    };
+
+    struct Totals {
+        QString sql;
+        int numCalls = 0;
+        qint64 totalUs = 0;
+        qint64 maxUs = 0;
+        qint64 numRows = 0;
+    };
+
+    static const int capacity = 256;
+    static const int slowCapacity = 64;
+
+    static QueryProfiler &instance();
+
+    void setEnabled(bool);
+    bool isEnabled() const;
+
+    void setSlowThresholdMs(int);
+    int slowThresholdMs() const;
+
+    // Debug builds only, the plans are worked out on the connection that ran the query
+    void setExplainSlowQueries(bool);
+    bool explainSlowQueries() const;
+
+    void record(Sample sample);
+    void clear();
+
+    // Oldest first
+    QVector<Sample> recentSamples() const;
+
+    // The latest queries over the threshold, oldest first
+    QVector<Sample> slowSamples() const;
+
+    // The queries that took the most time all together, slowest first
+    QVector<Totals> topQueries(int limit) const;
+
+    // Times a query from construction to destruction. A scope opened while another is running on the
+    // same thread doesn't record anything, so a helper that reads the rows can time the whole of it
+    // without the statement it runs being counted again.
+    class Scope {
+    public:
+        Scope(const QString &sql, int numParams, std::function<QStringList()> explain = nullptr);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        void setNumRows(int numRows) { numRows_ = numRows; }
+
+    private:
+        const QString sql_;
+        const int numParams_;
+        std::function<QStringList()> explain_;
+        int numRows_ = -1;
+        bool active_;
+        QElapsedTimer timer_;
+    };
+
+private:
+    QueryProfiler() = default;
+
+    mutable QMutex lock_;
+    QVector<Sample> samples_;
+    QVector<Sample> slowSamples_;
+    int nextSample_ = 0;
+    QHash<QString, Totals> totals_;
+
+    std::atomic<bool> enabled_ = true;
+    std::atomic<int> slowThresholdMs_ = 100;
+    std::atomic<bool> explainSlowQueries_ = false;
+};
+
+#endif //GAMEMATCHER_QUERYPROFILER_H
@@ -0,0 +1,120 @@
+#include "RotationTracker.h"
+
+#include <QSet>
+
+#include <algorithm>
+#include <map>
+
+RotationTracker::RotationTracker(const QVector<GameAllocation> &pastAllocations) {
+    std::map<GameId, QVector<MemberId>> games;
+    for (const auto &allocation : pastAllocations) {
+        games[allocation.gameId].push_back(allocation.memberId);
+    }
+
+    for (const auto &[gameId, players] : games) {
+        addGame(players);
+    }
+}
+
+void RotationTracker::addGame(const QVector<MemberId> &players) {
+    const auto gameIndex = numGames_++;
+
+    for (auto memberId : players) {
+        auto &entry = entries_[memberId];
+        if (entry.lastGameIndex == gameIndex) continue;
+
+        if (entry.active) queue_.erase(entry.queueKey(memberId));
+        entry.lastGameIndex = gameIndex;
+        entry.numGamesFor++;
+        if (entry.active) queue_.insert(entry.queueKey(memberId));
+    }
+}
+
+void RotationTracker::setActive(const BasePlayerInfo &player, bool active) {
+    auto &entry = entries_[player.memberId];
+    if (entry.active) queue_.erase(entry.queueKey(player.memberId));
+
+    entry.info = player;
+    if (active && !entry.active) entry.activeOrder = nextActiveOrder_++;
+    entry.active = active;
+    if (active) queue_.insert(entry.queueKey(player.memberId));
+}
+
+void RotationTracker::setActive(MemberId memberId, bool active) {
+    auto found = entries_.find(memberId);
+    if (found == entries_.end() || !found->info) {
+        if (active) qWarning() << "Member" << memberId << "can't be activated without their player info";
+        return;
+    }
+
+    setActive(*found->info, active);
+}
+
+void RotationTracker::setActivePlayers(const QVector<BasePlayerInfo> &players) {
+    QSet<MemberId> wanted;
+    for (const auto &player : players) {
+        wanted.insert(player.memberId);
+    }
+
+    for (auto iter = entries_.begin(); iter != entries_.end(); ++iter) {
+        if (iter->active && !wanted.contains(iter.key())) {
+            queue_.erase(iter->queueKey(iter.key()));
+            iter->active = false;
+        }
+    }
+
+    for (const auto &player : players) {
+        auto found = entries_.constFind(player.memberId);
+        if (found == entries_.constEnd() || !found->active || found->info != player) {
+            setActive(player, true);
+        }
+    }
+}
+
+bool RotationTracker::isActive(MemberId memberId) const {
+    auto found = entries_.constFind(memberId);
+    return found != entries_.constEnd() && found->active;
+}
+
+int RotationTracker::numGamesFor(MemberId memberId) const {
+    auto found = entries_.constFind(memberId);
+    return found == entries_.constEnd() ? 0 : found->numGamesFor;
+}
+
+int RotationTracker::numGamesOff(MemberId memberId) const {
+    auto found = entries_.constFind(memberId);
+    return found == entries_.constEnd() ? numGames_ : numGames_ - 1 - found->lastGameIndex;
+}
+
+QVector<PlayerInfo> RotationTracker::findEligiblePlayers(unsigned playerPerCourt, unsigned numCourt) const {
+    QVector<PlayerInfo> players;
+
+    if (queue_.empty() || playerPerCourt == 0 || numCourt == 0) return players;
+
+    // Least recently played first
+    auto playerAt = [this](const QueueKey &key) -> const BasePlayerInfo & {
+        return *entries_.constFind(std::get<2>(key))->info;
+    };
+
+    const size_t numMembersOn = std::min<size_t>(numCourt, queue_.size() / playerPerCourt) * playerPerCourt;
+
+    if (numGames_ == 0 || queue_.size() <= numMembersOn) {
+        // First game everyone is eligible, as is everyone when there are enough seats for all
+        players.reserve(queue_.size());
+        for (const auto &key : queue_) {
+            players.push_back(PlayerInfo(playerAt(key), false));
+        }
+        return players;
+    }
+
+    if (numMembersOn == 0) return players;
+
+    const auto lowestScore = std::get<0>(*std::next(queue_.begin(), numMembersOn - 1));
+    for (const auto &key : queue_) {
+        const auto score = std::get<0>(key);
+        if (score > lowestScore) break;
+        players.push_back(PlayerInfo(playerAt(key), score < lowestScore));
+    }
+
+    return players;
+}
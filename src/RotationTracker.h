@@ -0,0 +1,79 @@
+#ifndef GAMEMATCHER_ROTATIONTRACKER_H
+#define GAMEMATCHER_ROTATIONTRACKER_H
+
+#include "models.h"
+#include "PlayerInfo.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <optional>
+#include <set>
+#include <tuple>
+
+// Keeps the active players ordered by how long they have been waiting, so the bench rotation doesn't have
+// to be recomputed from the whole session every round. Committing a game or changing someone's
+// availability is O(log n) per player involved.
+//
+// The order is the same as EligiblePlayerFinder's `numGamesOff * 2000 - numGamesFor`: with game indices
+// counted from the start of the session, numGamesOff = numGames - 1 - lastGameIndex, so ranking by
+// `lastGameIndex * 2000 + numGamesFor` gives the same order without touching anyone who didn't play.
+// Ties are kept in the order players were activated.
+class RotationTracker {
+public:
+    RotationTracker() = default;
+
+    // Replay the past games of a session, in the order of their ids
+    explicit RotationTracker(const QVector<GameAllocation> &pastAllocations);
+
+    void addGame(const QVector<MemberId> &players);
+
+    // Active players are the ones who can be put on a court: checked in and not paused. Someone who stays
+    // active keeps their place among the ties, even when their info changes.
+    void setActive(const BasePlayerInfo &player, bool active);
+
+    // Only for players whose info has been given before
+    void setActive(MemberId memberId, bool active);
+
+    // Makes these exactly the active players, touching only the ones that changed
+    void setActivePlayers(const QVector<BasePlayerInfo> &players);
+
+    bool isActive(MemberId memberId) const;
+
+    int numGames() const { return numGames_; }
+
+    int numActive() const { return static_cast<int>(queue_.size()); }
+
+    int numGamesFor(MemberId memberId) const;
+
+    int numGamesOff(MemberId memberId) const;
+
+    int eligibilityScore(MemberId memberId) const {
+        return numGamesOff(memberId) * 2000 - numGamesFor(memberId);
+    }
+
+    // Same contract as EligiblePlayerFinder::findEligiblePlayers, for the active players
+    QVector<PlayerInfo> findEligiblePlayers(unsigned playerPerCourt, unsigned numCourt) const;
+
+private:
+    typedef std::tuple<qint64, qint64, MemberId> QueueKey;
+
+    struct Entry {
+        int lastGameIndex = -1;
+        int numGamesFor = 0;
+        qint64 activeOrder = 0;
+        bool active = false;
+        std::optional<BasePlayerInfo> info;
+
+        QueueKey queueKey(MemberId memberId) const {
+            return {static_cast<qint64>(lastGameIndex) * 2000 + numGamesFor, activeOrder, memberId};
+        }
+    };
+
+    QHash<MemberId, Entry> entries_;
+    std::set<QueueKey> queue_;
+    int numGames_ = 0;
+    qint64 nextActiveOrder_ = 0;
+};
+
+#endif //GAMEMATCHER_ROTATIONTRACKER_H
@@ -0,0 +1,216 @@
+#include "SchedulePlanner.h"
+
+#include "GameMatcher.h"
+#include "RotationTracker.h"
+
+#include <QSet>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+// The plan itself usually runs on the global pool and waits for its candidates. They get a pool of their own
+// so that wait can never hold up the very threads they need.
+static QThreadPool *candidatePool() {
+    static QThreadPool pool;
+    return &pool;
+}
+
+struct Candidate {
+    QVector<SchedulePlanner::Round> rounds;
+    qint64 score = 0;
+};
+
+static Candidate searchCandidate(const QVector<GameAllocation> &pastAllocations,
+                                 const QVector<SchedulePlanner::Round> &plannedRounds,
+                                 const QVector<Member> &players,
+                                 const QVector<CourtId> &courts,
+                                 unsigned playerPerCourt,
+                                 int numRounds,
+                                 int seed,
+                                 bool shuffle,
+                                 const CoPlayHistory *coPlayHistory,
+                                 const std::atomic<bool> *cancelled) {
+    Candidate candidate;
+
+    auto history = pastAllocations;
+    GameId nextGameId = 1;
+    for (const auto &allocation : pastAllocations) {
+        nextGameId = std::max(nextGameId, allocation.gameId + 1);
+    }
+
+    for (const auto &round : plannedRounds) {
+        for (const auto &allocation : round) {
+            history.push_back(allocation);
+            history.last().gameId = nextGameId;
+        }
+        nextGameId++;
+    }
+
+    std::mt19937 rng(seed);
+    auto roster = players;
+
+    // Shuffling only changes how ties are broken, so every candidate stays a valid greedy plan
+    if (shuffle) std::shuffle(roster.begin(), roster.end(), rng);
+
+    RotationTracker rotation(history);
+    for (const auto &player : roster) {
+        rotation.setActive(BasePlayerInfo(player), true);
+    }
+
+    QHash<MemberId, int> numGamesFor;
+    for (int i = plannedRounds.size(); i < numRounds; i++) {
+        if (cancelled && *cancelled) break;
+
+        auto round = GameMatcher::match(history, roster, courts, playerPerCourt, rng(), coPlayHistory, &rotation);
+        if (round.isEmpty()) break;
+
+        QVector<MemberId> roundPlayers;
+        for (auto &allocation : round) {
+            allocation.gameId = nextGameId;
+            history.push_back(allocation);
+            roundPlayers.push_back(allocation.memberId);
+            numGamesFor[allocation.memberId]++;
+            candidate.score += allocation.quality;
+        }
+
+        rotation.addGame(roundPlayers);
+
+        candidate.rounds.push_back(round);
+        nextGameId++;
+    }
+
+    // Uneven number of games is far worse than a slightly less balanced court
+    int minGames = std::numeric_limits<int>::max(), maxGames = 0;
+    for (const auto &player : players) {
+        auto games = numGamesFor.value(player.id, 0);
+        minGames = std::min(minGames, games);
+        maxGames = std::max(maxGames, games);
+    }
+
+    if (maxGames > minGames) {
+        candidate.score -= static_cast<qint64>(maxGames - minGames) * 1000 * playerPerCourt;
+    }
+
+    return candidate;
+}
+
+QVector<SchedulePlanner::Round>
+SchedulePlanner::plan(const QVector<GameAllocation> &pastAllocations,
+                      const QVector<Round> &plannedRounds,
+                      const QVector<Member> &players,
+                      const QVector<CourtId> &courts,
+                      unsigned playerPerCourt,
+                      int numRounds,
+                      int numCandidates,
+                      int seed,
+                      const CoPlayHistory *coPlayHistory,
+                      const std::atomic<bool> *cancelled) {
+    if (plannedRounds.size() >= numRounds || courts.isEmpty() ||
+        playerPerCourt == 0 || players.size() < static_cast<int>(playerPerCourt)) {
+        return plannedRounds;
+    }
+
+    QVector<QFuture<Candidate>> futures;
+    for (int i = 0; i < std::max(numCandidates, 1); i++) {
+        futures.push_back(QtConcurrent::run(candidatePool(), [=, &pastAllocations, &plannedRounds, &players, &courts] {
+            return searchCandidate(pastAllocations, plannedRounds, players, courts, playerPerCourt,
+                                   numRounds, seed + i, i > 0, coPlayHistory, cancelled);
+        }));
+    }
+
+    std::optional<Candidate> best;
+    for (auto &future : futures) {
+        auto candidate = future.result();
+        if (!best || candidate.rounds.size() > best->rounds.size() ||
+            (candidate.rounds.size() == best->rounds.size() && candidate.score > best->score)) {
+            best = std::move(candidate);
+        }
+    }
+
+    if (cancelled && *cancelled) return plannedRounds;
+    return plannedRounds + best->rounds;
+}
+
+void SchedulePlanner::setPlan(std::optional<GameId> lastGameId,
+                              const QVector<Member> &players,
+                              const QVector<CourtId> &courts,
+                              QVector<Round> rounds) {
+    lastGameId_ = lastGameId;
+    courts_ = courts;
+    rounds_ = std::move(rounds);
+    roster_.clear();
+    for (const auto &player : players) {
+        roster_.insert(player.id, player);
+    }
+}
+
+int SchedulePlanner::invalidate(std::optional<GameId> lastGameId,
+                                const QVector<Member> &players,
+                                const QVector<CourtId> &courts) {
+    if (rounds_.isEmpty()) return 0;
+
+    // A game was made or withdrawn outside of the plan, or the courts changed: nothing holds anymore
+    if (lastGameId != lastGameId_ || courts != courts_) {
+        rounds_.clear();
+        return 0;
+    }
+
+    QSet<MemberId> gone;
+    for (auto iter = roster_.constBegin(); iter != roster_.constEnd(); ++iter) {
+        gone.insert(iter.key());
+    }
+
+    for (const auto &player : players) {
+        auto found = roster_.constFind(player.id);
+        if (found == roster_.constEnd()) {
+            // Newcomers are the most eligible players right away, so every round is affected
+            rounds_.clear();
+            return 0;
+        }
+
+        if (found->level == player.level && found->gender == player.gender) {
+            gone.remove(player.id);
+        }
+    }
+
+    if (gone.isEmpty()) return rounds_.size();
+
+    // Rounds before the first one that seats someone who has left (or changed) can still be played as is
+    int numKept = 0;
+    while (numKept < rounds_.size() &&
+           std::none_of(rounds_[numKept].begin(), rounds_[numKept].end(), [&](const GameAllocation &a) {
+               return gone.contains(a.memberId);
+           })) {
+        numKept++;
+    }
+
+    rounds_.resize(numKept);
+    roster_.clear();
+    for (const auto &player : players) {
+        roster_.insert(player.id, player);
+    }
+
+    return numKept;
+}
+
+std::optional<SchedulePlanner::Round> SchedulePlanner::nextRound(std::optional<GameId> lastGameId,
+                                                                 const QVector<Member> &players,
+                                                                 const QVector<CourtId> &courts) {
+    if (invalidate(lastGameId, players, courts) == 0) return std::nullopt;
+    return rounds_.first();
+}
+
+void SchedulePlanner::roundStarted(GameId gameId) {
+    if (!rounds_.isEmpty()) rounds_.pop_front();
+    lastGameId_ = gameId;
+}
+
+void SchedulePlanner::clear() {
+    lastGameId_.reset();
+    roster_.clear();
+    courts_.clear();
+    rounds_.clear();
+}
@@ -0,0 +1,67 @@
+#ifndef GAMEMATCHER_SCHEDULEPLANNER_H
+#define GAMEMATCHER_SCHEDULEPLANNER_H
+
+#include "models.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <atomic>
+#include <optional>
+
+class CoPlayHistory;
+
+// Keeps the next few rounds of a session planned ahead, so starting a game is a lookup instead of a search.
+// The plan is tied to the roster and courts it was made for: when those change, only the rounds from the
+// first affected one onwards are dropped.
+class SchedulePlanner {
+public:
+    typedef QVector<GameAllocation> Round;
+
+    // Plan up to numRounds rounds following pastAllocations and the given planned rounds (which are kept as is).
+    // numCandidates randomised searches run in parallel on the planner's own thread pool, and the plan that is
+    // fairest overall wins. Once `cancelled` is set the searches stop after their current round and only the
+    // planned rounds are returned.
+    static QVector<Round> plan(const QVector<GameAllocation> &pastAllocations,
+                               const QVector<Round> &plannedRounds,
+                               const QVector<Member> &players,
+                               const QVector<CourtId> &courts,
+                               unsigned playerPerCourt,
+                               int numRounds,
+                               int numCandidates,
+                               int seed,
+                               const CoPlayHistory *coPlayHistory = nullptr,
+                               const std::atomic<bool> *cancelled = nullptr);
+
+    void setPlan(std::optional<GameId> lastGameId,
+                 const QVector<Member> &players,
+                 const QVector<CourtId> &courts,
+                 QVector<Round> rounds);
+
+    // Drop the rounds that don't hold anymore. Returns the number of rounds kept.
+    int invalidate(std::optional<GameId> lastGameId,
+                   const QVector<Member> &players,
+                   const QVector<CourtId> &courts);
+
+    // The round to play next, if the plan still holds
+    std::optional<Round> nextRound(std::optional<GameId> lastGameId,
+                                   const QVector<Member> &players,
+                                   const QVector<CourtId> &courts);
+
+    // The next round has been turned into the given game
+    void roundStarted(GameId gameId);
+
+    void clear();
+
+    const QVector<Round> &rounds() const { return rounds_; }
+
+    const QVector<CourtId> &courts() const { return courts_; }
+
+private:
+    std::optional<GameId> lastGameId_;
+    QHash<MemberId, Member> roster_;
+    QVector<CourtId> courts_;
+    QVector<Round> rounds_;
+};
+
+#endif //GAMEMATCHER_SCHEDULEPLANNER_H
@@ -16,15 +16,45 @@
 #include "CourtDisplayLayout.h"
 #include "PlayerTableDialog.h"
 #include "PlayerStatsDialog.h"
-
+#include "GameMatcher.h"
+#include "SchedulePlanner.h"
+#include "RotationTracker.h"
+#include "CoPlayHistory.h"
+#include "LastSelectedCourts.h"
+
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <QTimer>
 #include <QMenu>
 #include <QSoundEffect>
 #include <QApplication>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
 
 static const auto alarmDurationSeconds = 15;
 
+static const SettingKey skPlanRoundsAhead = QStringLiteral("plan_rounds_ahead");
+static const auto defaultPlanRoundsAhead = 4;
+
+static void styleBenchItem(QListWidgetItem *listItem, const Member &member) {
+    QFont itemFont;
+    itemFont.setPointSize(18);
+    itemFont.setBold(true);
+    itemFont.setUnderline(member.paid == false);
+
+    listItem->setData(Qt::UserRole, QVariant::fromValue(member));
+    listItem->setForeground(MemberPainter::colorForMember(member));
+    listItem->setFont(itemFont);
+    if (member.status == Member::CheckedInPaused) {
+        listItem->setText(SessionPage::tr("%1 (paused)").arg(member.displayName));
+    } else {
+        listItem->setText(member.displayName);
+    }
+}
+
 struct SessionPage::Impl {
     ClubRepository *repo;
 
@@ -35,6 +65,147 @@ struct SessionPage::Impl {
     std::optional<GameInfo> lastGame;
     QTimer gameTimer = QTimer();
     QSoundEffect sound = QSoundEffect();
+
+    // The session's bench rotation, kept up to date from the repository's signals and loaded again only when
+    // a game is changed or withdrawn
+    std::optional<RotationTracker> rotation;
+    std::optional<GameId> rotationLastGameId;
+
+    const RotationTracker &sessionRotation() {
+        if (!rotation) {
+            auto pastAllocations = repo->getPastAllocations(session.session.id);
+            rotation.emplace(pastAllocations);
+            rotationLastGameId.reset();
+            for (const auto &allocation : pastAllocations) {
+                if (!rotationLastGameId || allocation.gameId > *rotationLastGameId) {
+                    rotationLastGameId = allocation.gameId;
+                }
+            }
+            for (const auto &member : repo->getMembers(CheckedIn{session.session.id, false})) {
+                rotation->setActive(BasePlayerInfo(member), true);
+            }
+        }
+        return *rotation;
+    }
+
+    void addGamesToRotation() {
+        if (!rotation) return;
+
+        QVector<MemberId> players;
+        std::optional<GameId> gameId;
+        for (const auto &allocation : repo->getAllocationsSince(session.session.id, rotationLastGameId)) {
+            if (gameId && allocation.gameId != *gameId) {
+                rotation->addGame(players);
+                players.clear();
+            }
+            gameId = allocation.gameId;
+            players.push_back(allocation.memberId);
+        }
+
+        if (gameId) {
+            rotation->addGame(players);
+            rotationLastGameId = gameId;
+        }
+    }
+
+    SchedulePlanner planner;
+    QFutureWatcher<QVector<SchedulePlanner::Round>> planWatcher;
+    std::shared_ptr<std::atomic<bool>> planCancelled;
+    QTimer planTimer = QTimer();
+    bool planAgain = false;
+
+    struct PlanRequest {
+        std::optional<GameId> lastGameId;
+        QVector<Member> players;
+        QVector<CourtId> courts;
+    } planRequest;
+
+    int numRoundsAhead() const {
+        return repo->getSettingValue<int>(skPlanRoundsAhead).value_or(0);
+    }
+
+    QVector<CourtId> plannedCourts() const {
+        QSet<CourtId> lastCourts;
+        if (lastGame) {
+            for (const auto &court : lastGame->courts) {
+                lastCourts.insert(court.courtId);
+            }
+        }
+
+        QVector<CourtId> courts;
+        for (const auto &court : session.courts) {
+            if (lastCourts.isEmpty() || lastCourts.contains(court.id)) courts.push_back(court.id);
+        }
+        return courts;
+    }
+
+    // Applies a change to a member waiting on the bench without reloading, false if they aren't there
+    bool patchBenchMember(MemberId memberId, const std::function<void(Member &)> &change) {
+        for (int i = 0, size = ui.benchList->count(); i < size; i++) {
+            auto listItem = ui.benchList->item(i);
+            auto member = listItem->data(Qt::UserRole).value<Member>();
+            if (member.id != memberId) continue;
+
+            change(member);
+            styleBenchItem(listItem, member);
+            if (lastGame) {
+                for (auto &waiting : lastGame->waiting) {
+                    if (waiting.id == memberId) change(waiting);
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // The courts picked for the last game: the ones it is played on plus any selected that it couldn't fill
+    QVector<CourtId> gameCourtIds() const {
+        auto selected = LastSelectedCourt::fromString(
+                repo->getSettingValue<QString>(skLastSelectedCourts).value_or(QString()));
+        if (selected && selected->sessionId != session.session.id) selected.reset();
+
+        QVector<CourtId> courtIds;
+        for (const auto &court : session.courts) {
+            auto inGame = std::any_of(lastGame->courts.begin(), lastGame->courts.end(), [&](const CourtPlayers &c) {
+                return c.courtId == court.id;
+            });
+            if (inGame || (selected && selected->selectedCourts.contains(court.id))) courtIds.push_back(court.id);
+        }
+        return courtIds;
+    }
+
+    // Someone on court has left or paused, or enough people are waiting to open a court the game doesn't use
+    bool hasLateChanges() const {
+        if (!lastGame) return false;
+        for (const auto &court : lastGame->courts) {
+            for (const auto &player : court.players) {
+                if (player.status != Member::CheckedIn) return true;
+            }
+        }
+
+        if (lastGame->courts.size() >= gameCourtIds().size()) return false;
+        auto numWaiting = std::count_if(lastGame->waiting.begin(), lastGame->waiting.end(), [](const Member &m) {
+            return m.status == Member::CheckedIn;
+        });
+        return numWaiting >= session.session.numPlayersPerCourt;
+    }
+
+    bool applyLateChanges() {
+        QVector<GameAllocation> currentGame;
+        for (const auto &court : lastGame->courts) {
+            for (const auto &player : court.players) {
+                currentGame.push_back(GameAllocation(lastGame->id, court.courtId, player.id, court.courtQuality));
+            }
+        }
+
+        auto allocations = GameMatcher::repair(repo->getPastAllocations(session.session.id),
+                                               currentGame,
+                                               repo->getMembers(CheckedIn{session.session.id, false}),
+                                               gameCourtIds(),
+                                               session.session.numPlayersPerCourt);
+        return !allocations.isEmpty() &&
+               repo->replaceGameAllocations(session.session.id, lastGame->id, allocations);
+    }
 };
 
 SessionPage::SessionPage(Impl *d, QWidget *parent)
@@ -51,8 +222,52 @@ SessionPage::SessionPage(Impl *d, QWidget *parent)
     d->sound.setSource(QUrl::fromLocalFile(QStringLiteral(":/sound/alarm_clock.wav")));
     d->sound.setLoopCount(QSoundEffect::Infinite);
 
-    connect(d->repo, &ClubRepository::sessionChanged, [=](auto sessionId) {
-        if (d->session.session.id == sessionId) {
+    connect(d->repo, &ClubRepository::changesFlushed, this, [=](const ChangeSet &changes) {
+        if (changes.members || changes.sessions.contains(d->session.session.id)) {
+            reload();
+        }
+    });
+
+    connect(d->repo, &ClubRepository::playerCheckedIn, this, [=](SessionId sessionId, const Member &member) {
+        if (d->session.session.id != sessionId || !d->rotation) return;
+
+        // Checking in again replaces the player along with their past allocations
+        if (d->rotation->numGamesFor(member.id) > 0) {
+            d->rotation.reset();
+        } else {
+            d->rotation->setActive(BasePlayerInfo(member), member.status == Member::CheckedIn);
+        }
+    });
+    connect(d->repo, &ClubRepository::playerCheckedOut, this, [=](SessionId sessionId, MemberId memberId) {
+        if (d->session.session.id == sessionId && d->rotation) d->rotation->setActive(memberId, false);
+    });
+    connect(d->repo, &ClubRepository::memberUpdated, this, [=](const BaseMember &member) {
+        if (d->rotation && d->rotation->isActive(member.id)) {
+            d->rotation->setActive(BasePlayerInfo(member.id, member.gender, member.level), true);
+        }
+    });
+    connect(d->repo, &ClubRepository::gameCreated, this, [=](SessionId sessionId) {
+        if (d->session.session.id == sessionId) d->addGamesToRotation();
+    });
+    auto resetRotation = [=](SessionId sessionId) {
+        if (d->session.session.id == sessionId) d->rotation.reset();
+    };
+    connect(d->repo, &ClubRepository::gameChanged, this, resetRotation);
+    connect(d->repo, &ClubRepository::gameWithdrawn, this, resetRotation);
+
+    // Paid and pause flips are the busiest changes, they only restyle the bench row when they can
+    connect(d->repo, &ClubRepository::paidChanged, this, [=](SessionId sessionId, MemberId memberId, bool paid) {
+        if (d->session.session.id != sessionId) return;
+        if (!d->patchBenchMember(memberId, [=](Member &m) { m.paid = paid; })) reload();
+    });
+    connect(d->repo, &ClubRepository::pauseChanged, this, [=](SessionId sessionId, MemberId memberId, bool paused) {
+        if (d->session.session.id != sessionId) return;
+        if (d->rotation) d->rotation->setActive(memberId, !paused);
+        if (d->patchBenchMember(memberId, [=](Member &m) {
+            m.status = paused ? Member::CheckedInPaused : Member::CheckedIn;
+        })) {
+            d->planTimer.start();
+        } else {
             reload();
         }
     });
@@ -61,6 +276,19 @@ SessionPage::SessionPage(Impl *d, QWidget *parent)
     d->gameTimer.setSingleShot(true);
     connect(&d->gameTimer, &QTimer::timeout, this, &SessionPage::updateElapseTime);
 
+    // Deferred so a game started from the plan has been accounted for before the plan is checked
+    d->planTimer.setInterval(0);
+    d->planTimer.setSingleShot(true);
+    connect(&d->planTimer, &QTimer::timeout, this, &SessionPage::updatePlan);
+    connect(&d->planWatcher, &QFutureWatcherBase::finished, [=] {
+        d->planner.setPlan(d->planRequest.lastGameId, d->planRequest.players, d->planRequest.courts,
+                           d->planWatcher.result());
+        if (d->planAgain) {
+            d->planAgain = false;
+            updatePlan();
+        }
+    });
+
     reload();
 
     d->ui.benchList->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -100,7 +328,9 @@ SessionPage::SessionPage(Impl *d, QWidget *parent)
             }
         }
 
-        auto dialog = NewGameDialog::create(d->session.session.id, d->repo, this);
+        auto dialog = NewGameDialog::create(d->session.session.id, d->repo, this,
+                                            d->numRoundsAhead() > 0 ? &d->planner : nullptr,
+                                            d->sessionRotation());
         if (!dialog) {
             QMessageBox::warning(this, tr("Error"), tr("Unable to open new game dialog"));
             return;
@@ -129,6 +359,24 @@ SessionPage::SessionPage(Impl *d, QWidget *parent)
             });
         }
 
+        if (d->hasLateChanges()) {
+            connect(optionMenu->addAction(tr("Update game for late changes")), &QAction::triggered, [=] {
+                if (!d->lastGame || !d->applyLateChanges()) {
+                    QMessageBox::warning(this, tr("Error"), tr("Unable to update the game"));
+                }
+            });
+        }
+
+        auto planAction = optionMenu->addAction(tr("Plan rounds ahead"));
+        planAction->setCheckable(true);
+        planAction->setChecked(d->numRoundsAhead() > 0);
+        connect(planAction, &QAction::toggled, [=](bool checked) {
+            if (!d->repo->saveSetting(skPlanRoundsAhead, checked ? defaultPlanRoundsAhead : 0)) {
+                qWarning() << "Unable to save plan rounds ahead";
+            }
+            d->planTimer.start();
+        });
+
         connect(optionMenu->addAction(tr("About Qt")), &QAction::triggered,
                 QCoreApplication::instance(), &QApplication::aboutQt);
 
@@ -155,18 +403,19 @@ SessionPage::SessionPage(Impl *d, QWidget *parent)
             d->sound.stop();
         }
     });
-
-    connect(d->repo, &ClubRepository::memberChanged, this, &SessionPage::reload);
 }
 
 SessionPage::~SessionPage() {
     d->sound.stop();
+    if (d->planCancelled) *d->planCancelled = true;
+    d->planWatcher.waitForFinished();
     delete d;
 }
 
 void SessionPage::reload() {
     d->lastGame = d->repo->getLastGameInfo(d->session.session.id);
     updateElapseTime();
+    d->planTimer.start();
 
     auto createWidget = [this]() {
         auto display = new CourtDisplay(this);
@@ -181,26 +430,65 @@ void SessionPage::reload() {
     setEntities(d->courtLayout, d->lastGame ? d->lastGame->courts : QVector<CourtPlayers>(), createWidget,
                 updateWidget);
 
-    QFont itemFont;
-    itemFont.setPointSize(18);
-    itemFont.setBold(true);
-
     d->ui.benchList->clear();
     for (const auto &item : (d->lastGame ? d->lastGame->waiting : d->repo->getMembers(
             CheckedIn{d->session.session.id}))) {
-        auto listItem = new QListWidgetItem(item.displayName, d->ui.benchList);
-        listItem->setForeground(MemberPainter::colorForMember(item));
-        listItem->setData(Qt::UserRole, QVariant::fromValue(item));
-        bool isPaused = item.status == Member::CheckedInPaused;
-        if (item.paid == false) {
-            itemFont.setUnderline(true);
-        }
-        listItem->setFont(itemFont);
-        itemFont.setUnderline(false);
-        if (isPaused) {
-            listItem->setText(tr("%1 (paused)").arg(listItem->text()));
-        }
+        styleBenchItem(new QListWidgetItem(d->ui.benchList), item);
+    }
+}
+
+void SessionPage::updatePlan() {
+    auto numRounds = d->numRoundsAhead();
+    if (numRounds <= 0) {
+        d->planner.clear();
+        return;
     }
+
+    if (d->planWatcher.isRunning()) {
+        d->planAgain = true;
+        return;
+    }
+
+    d->planRequest = {d->lastGame ? std::optional<GameId>(d->lastGame->id) : std::nullopt,
+                      d->repo->getMembers(CheckedIn{d->session.session.id, false}),
+                      d->plannedCourts()};
+
+    // Only the rounds that no longer hold are planned again
+    d->planner.invalidate(d->planRequest.lastGameId, d->planRequest.players, d->planRequest.courts);
+    if (d->planner.rounds().size() >= numRounds) return;
+
+    // The game history is read on the worker when it can have a connection of its own
+    const bool readInWorker = d->repo->canReadOnAnyThread();
+    QVector<GameAllocation> pastAllocations;
+    CoPlayHistory coPlayHistory;
+    if (!readInWorker) {
+        pastAllocations = d->repo->getPastAllocations(d->session.session.id);
+        coPlayHistory = d->repo->getCoPlayHistory(d->session.session.id);
+    }
+
+    d->planCancelled = std::make_shared<std::atomic<bool>>(false);
+    d->planWatcher.setFuture(
+            QtConcurrent::run([repo = d->repo,
+                                      cancelled = d->planCancelled,
+                                      readInWorker,
+                                      sessionId = d->session.session.id,
+                                      pastAllocations = std::move(pastAllocations),
+                                      coPlayHistory = std::move(coPlayHistory),
+                                      plannedRounds = d->planner.rounds(),
+                                      players = d->planRequest.players,
+                                      courts = d->planRequest.courts,
+                                      numPlayersPerCourt = d->session.session.numPlayersPerCourt,
+                                      numRounds]() mutable {
+                if (*cancelled) return plannedRounds;
+                if (auto reader = readInWorker ? repo->readerForCurrentThread() : nullptr) {
+                    pastAllocations = reader->getPastAllocations(sessionId);
+                    coPlayHistory = reader->getCoPlayHistory(sessionId);
+                }
+                return SchedulePlanner::plan(pastAllocations, plannedRounds, players, courts,
+                                             numPlayersPerCourt, numRounds, QThread::idealThreadCount(),
+                                             QDateTime::currentMSecsSinceEpoch(), &coPlayHistory,
+                                             cancelled.get());
+            }));
 }
 
 void SessionPage::changeEvent(QEvent *event) {
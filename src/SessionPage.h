@@ -30,6 +30,7 @@ protected:
 private slots:
     void reload();
     void updateElapseTime();
+    void updatePlan();
 
     void showMemberMenuAt(const Member &, const QPoint &);
 
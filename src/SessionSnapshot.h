@@ -0,0 +1,135 @@
+#ifndef GAMEMATCHER_SESSIONSNAPSHOT_H
+#define GAMEMATCHER_SESSIONSNAPSHOT_H
+
+#include "models.h"
+#include "MemberFilter.h"
+#include "ClubRepositoryModels.h"
+#include "NameFormatUtils.h"
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include <algorithm>
+#include <optional>
+
+// In-memory copy of a session's players and last game. The repository applies its own changes to it
+// as they are made, so the session views can be served without going back to the database.
+struct SessionSnapshot {
+    struct CourtAllocation {
+        CourtId courtId;
+        int quality;
+        QVector<MemberId> players;
+    };
+
+    struct LastGame {
+        GameId id;
+        qlonglong startTime;
+        qlonglong durationSeconds;
+        QVector<CourtAllocation> courts;
+    };
+
+    SessionId sessionId = 0;
+
+    // Courts in their display order
+    QVector<Court> courts;
+
+    // Everyone who has checked in, ordered by name the same way the session queries are
+    QVector<Member> members;
+
+    std::optional<LastGame> lastGame;
+
+    static bool nameOrder(const Member &lhs, const Member &rhs) {
+        if (lhs.firstName != rhs.firstName) return lhs.firstName < rhs.firstName;
+        return lhs.lastName < rhs.lastName;
+    }
+
+    void setMembers(QVector<Member> list) {
+        members = std::move(list);
+        formatMemberDisplayNames(members);
+    }
+
+    Member *findMember(MemberId memberId) {
+        auto found = std::find_if(members.begin(), members.end(), [=](const Member &m) { return m.id == memberId; });
+        return found == members.end() ? nullptr : &*found;
+    }
+
+    void upsertMember(const Member &member) {
+        members.erase(std::remove_if(members.begin(), members.end(), [&](const Member &m) {
+            return m.id == member.id;
+        }), members.end());
+        members.insert(std::upper_bound(members.begin(), members.end(), member, &SessionSnapshot::nameOrder), member);
+        formatMemberDisplayNames(members);
+    }
+
+    void updateMember(const BaseMember &member) {
+        auto found = findMember(member.id);
+        if (!found) return;
+
+        Member updated = *found;
+        static_cast<BaseMember &>(updated) = member;
+        updated.registerDate = found->registerDate;
+        updated.email = member.email.trimmed();
+        updated.phone = member.phone.trimmed();
+        upsertMember(updated);
+    }
+
+    // Members for an AllSession or CheckedIn filter of this session, with display names formatted among them
+    QVector<Member> membersFor(const MemberSearchFilter &filter) const {
+        auto checkedIn = std::get_if<CheckedIn>(&filter);
+        if (!checkedIn) return members;
+
+        QVector<Member> result;
+        for (const auto &m : members) {
+            if (m.status == Member::CheckedOut) continue;
+            if (checkedIn->paused && *checkedIn->paused != (m.status == Member::CheckedInPaused)) continue;
+            result.push_back(m);
+        }
+
+        formatMemberDisplayNames(result);
+        return result;
+    }
+
+    std::optional<GameInfo> lastGameInfo() const {
+        if (!lastGame) return std::nullopt;
+
+        QHash<MemberId, const Member *> memberById;
+        for (const auto &m : members) {
+            memberById.insert(m.id, &m);
+        }
+
+        GameInfo info;
+        info.id = lastGame->id;
+        info.startTime = lastGame->startTime;
+        info.durationSeconds = lastGame->durationSeconds;
+
+        QSet<MemberId> onCourt;
+        for (const auto &court : lastGame->courts) {
+            auto found = std::find_if(courts.begin(), courts.end(), [&](const Court &c) {
+                return c.id == court.courtId;
+            });
+
+            CourtPlayers players;
+            players.courtId = court.courtId;
+            players.courtName = found != courts.end() ? found->name : QString();
+            players.courtQuality = court.quality;
+            for (auto memberId : court.players) {
+                if (auto member = memberById.value(memberId)) {
+                    players.players.append(*member);
+                    onCourt.insert(memberId);
+                }
+            }
+            if (!players.players.isEmpty()) info.courts.append(players);
+        }
+
+        for (const auto &m : members) {
+            if (!onCourt.contains(m.id) && m.status != Member::CheckedOut) {
+                info.waiting.append(m);
+            }
+        }
+
+        return info;
+    }
+};
+
+#endif //GAMEMATCHER_SESSIONSNAPSHOT_H
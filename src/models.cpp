@@ -12,6 +12,8 @@ void registerModels() {
     qRegisterMetaType<SessionId>("SessionId");
     qRegisterMetaType<MemberId>("MemberId");
     qRegisterMetaType<SettingKey>("SettingKey");
+    qRegisterMetaType<BaseMember>();
     qRegisterMetaType<Member>();
     qRegisterMetaType<CourtPlayers>();
+    qRegisterMetaType<ChangeSet>();
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "ClubRepository.h"
+
+#include "TestUtils.h"
+
+#include <catch2/catch.hpp>
+#include <memory>
+#include <QTemporaryDir>
+
+// Benchmarks are hidden by default, run them with: GameMatcher_test "[!benchmark]"
+
+static const int numBenchmarkMembers = 120;
+static const int numBenchmarkCheckedIn = 60;
+
+static std::optional<SessionData> populateSession(ClubRepository &repo, int numCourts,
+                                                  int numCheckedIn = numBenchmarkCheckedIn) {
+    QVector<CourtConfiguration> courts;
+    for (int i = 0; i < numCourts; i++) {
+        courts.push_back({QStringLiteral("Court %1").arg(i + 1), i});
+    }
+
+    auto session = repo.createSession(10, QStringLiteral("Place"), QStringLiteral("Announcement"), 4, courts);
+    if (!session) return std::nullopt;
+
+    for (int i = 0; i < numBenchmarkMembers; i++) {
+        auto member = repo.createMember(QStringLiteral("First%1").arg(i), QStringLiteral("Last%1").arg(i),
+                                        (i % 2 == 0) ? Member::Male : Member::Female, 1 + i % 5,
+                                        QString(), QString());
+        if (!member) return std::nullopt;
+        if (i < numCheckedIn && !repo.checkIn(session->session.id, member->id, i % 3 != 0)) {
+            return std::nullopt;
+        }
+    }
+
+    return session;
+}
+
+static QVector<GameAllocation> benchmarkGame(ClubRepository &repo, const SessionData &session) {
+    QVector<GameAllocation> allocations;
+    auto players = repo.getMembers(CheckedIn{session.session.id});
+    for (int i = 0, size = std::min(players.size(), session.courts.size() * 4); i < size; i++) {
+        allocations.push_back(GameAllocation(0, session.courts[i / 4].id, players[i].id, 50));
+    }
+    return allocations;
+}
+
+TEST_CASE("ClubRepository session page reload", "[!benchmark]") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    auto session = populateSession(*repo, 8);
+    REQUIRE(session);
+    REQUIRE(repo->createGame(session->session.id, benchmarkGame(*repo, *session), 900));
+
+    const auto sessionId = session->session.id;
+    auto reload = [&] {
+        auto lastGame = repo->getLastGameInfo(sessionId);
+        auto members = repo->getMembers(CheckedIn{sessionId});
+        auto clubName = repo->getClubName();
+        auto level = repo->getLevelRange();
+        return lastGame->courts.size() + members.size() + clubName.size() + level.max;
+    };
+
+    auto cached = GENERATE(false, true);
+    repo->setStatementCacheEnabled(cached);
+
+    BENCHMARK(cached ? "reload with statement cache" : "reload without statement cache") {
+        return reload();
+    };
+
+    auto stats = repo->getStatementCacheStats();
+    if (cached) {
+        REQUIRE(stats.hits > stats.misses);
+    }
+}
+
+TEST_CASE("ClubRepository session snapshot", "[!benchmark]") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    auto session = populateSession(*repo, 8);
+    REQUIRE(session);
+    REQUIRE(repo->createGame(session->session.id, benchmarkGame(*repo, *session), 900));
+
+    const auto sessionId = session->session.id;
+    const auto memberId = repo->getMembers(CheckedIn{sessionId}).first().id;
+
+    auto snapshot = GENERATE(false, true);
+    repo->setSessionSnapshotEnabled(snapshot);
+
+    // Toggling one flag and reloading the page is the common case at the front desk
+    bool paid = false;
+    BENCHMARK(snapshot ? "toggle paid with session snapshot" : "toggle paid without session snapshot") {
+        repo->setPaid(sessionId, memberId, paid = !paid);
+        return repo->getLastGameInfo(sessionId)->waiting.size() + repo->getMembers(CheckedIn{sessionId}).size();
+    };
+}
+
+TEST_CASE("ClubRepository member search", "[!benchmark]") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    auto session = populateSession(*repo, 4);
+    REQUIRE(session);
+
+    int i = 0;
+    repo->importMembers([&](BaseMember &m) {
+        if (i >= 10000) return false;
+        m.firstName = QStringLiteral("Imported%1").arg(i);
+        m.lastName = QStringLiteral("Member%1").arg(i++ % 397);
+        m.gender = BaseMember::Female;
+        m.level = 3;
+        return true;
+    }, nullptr);
+    REQUIRE(repo->getMembers(AllMembers{}).size() > 10000);
+
+    BENCHMARK("find member among 10k to check in") {
+        return repo->findMember(NonCheckedIn{session->session.id}, QStringLiteral("Imported12 Member1")).size();
+    };
+}
+
+TEST_CASE("ClubRepository member import", "[!benchmark]") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    // Every run brings in names no one has yet, on top of those from the runs before
+    int run = 0;
+    BENCHMARK("import 5k members") {
+        int i = 0;
+        run++;
+        return repo->importMembers([&](BaseMember &m) {
+            if (i >= 5000) return false;
+            m.firstName = QStringLiteral("Run%1").arg(run);
+            m.lastName = QStringLiteral("Member%1").arg(i++);
+            m.gender = BaseMember::Male;
+            m.level = 3;
+            return true;
+        });
+    };
+}
+
+TEST_CASE("ClubRepository check in throughput", "[!benchmark]") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    auto [name, profile] = GENERATE(table<const char *, DatabaseProfile>(
+            {
+                    {"check in with SQLite defaults", DatabaseProfile::sqliteDefaults()},
+                    {"check in with tuned profile", DatabaseProfile()},
+            }));
+
+    std::unique_ptr<ClubRepository> repo(
+            ClubRepository::open(nullptr, dir.filePath(QStringLiteral("club.db")), profile));
+    REQUIRE(repo);
+
+    auto session = populateSession(*repo, 4);
+    REQUIRE(session);
+    auto members = repo->getMembers(AllMembers{});
+    REQUIRE(members.size() == numBenchmarkMembers);
+
+    // Every check in is its own transaction, like it is at the front desk
+    int i = 0;
+    BENCHMARK(name) {
+        auto &member = members[i++ % members.size()];
+        return repo->checkIn(session->session.id, member.id, true);
+    };
+}
+
+TEST_CASE("ClubRepository create game", "[!benchmark]") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    auto session = populateSession(*repo, 25, 100);
+    REQUIRE(session);
+
+    auto allocations = benchmarkGame(*repo, *session);
+    REQUIRE(allocations.size() == 100);
+
+    BENCHMARK("create game with 100 allocations") {
+        return repo->createGame(session->session.id, allocations, 900);
+    };
+}
@@ -3,12 +3,63 @@
 //
 
 #include "ClubRepository.h"
+#include "CoPlayHistory.h"
+#include "GameStats.h"
 
 #include "TestUtils.h"
 
 #include <catch2/catch.hpp>
 #include <memory>
+#include <QEventLoop>
+#include <QFile>
 #include <QSignalSpy>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QRegularExpression>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtTest/QTest>
+
+static bool sameDisplayNames(const QVector<Member> &lhs, const QVector<Member> &rhs) {
+    return lhs == rhs && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const Member &a, const Member &b) {
+        return a.displayName == b.displayName;
+    });
+}
+
+// Compares what the session views read from the snapshot against the database
+static void requireSnapshotMatchesDatabase(ClubRepository &repo, SessionId sessionId) {
+    const QVector<MemberSearchFilter> filters = {
+            AllSession{sessionId},
+            CheckedIn{sessionId},
+            CheckedIn{sessionId, true},
+            CheckedIn{sessionId, false},
+    };
+
+    QVector<QVector<Member>> fromSnapshot;
+    for (const auto &filter : filters) {
+        fromSnapshot.push_back(repo.getMembers(filter));
+    }
+    auto lastGameFromSnapshot = repo.getLastGameInfo(sessionId);
+
+    repo.setSessionSnapshotEnabled(false);
+    for (int i = 0; i < filters.size(); i++) {
+        REQUIRE(sameDisplayNames(fromSnapshot[i], repo.getMembers(filters[i])));
+    }
+
+    auto lastGame = repo.getLastGameInfo(sessionId);
+    repo.setSessionSnapshotEnabled(true);
+
+    REQUIRE(lastGame.has_value() == lastGameFromSnapshot.has_value());
+    if (!lastGame) return;
+    REQUIRE(lastGame->id == lastGameFromSnapshot->id);
+    REQUIRE(lastGame->startTime == lastGameFromSnapshot->startTime);
+    REQUIRE(lastGame->durationSeconds == lastGameFromSnapshot->durationSeconds);
+    REQUIRE(lastGame->courts == lastGameFromSnapshot->courts);
+    REQUIRE(sameDisplayNames(lastGame->waiting, lastGameFromSnapshot->waiting));
+}
 
 TEST_CASE("ClubRepository") {
     std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
@@ -54,6 +105,158 @@ TEST_CASE("ClubRepository") {
         CHECK(!repo->getSetting(name));
     }
 
+    SECTION("settings cache") {
+        const SettingKey key = QStringLiteral("key");
+        REQUIRE(repo->saveSetting(key, true));
+        REQUIRE(repo->getSetting(key) == QStringLiteral("1"));
+        REQUIRE(repo->getSettingValue<bool>(key) == true);
+
+        REQUIRE(repo->saveSetting(key, false));
+        REQUIRE(repo->getSettingValue<bool>(key) == false);
+        REQUIRE(repo->getSettingValue<int>(key) == 0);
+
+        REQUIRE(repo->saveSetting(key, QStringLiteral("word")));
+        REQUIRE(!repo->getSettingValue<int>(key));
+        REQUIRE(repo->getSettingValue<QString>(key) == QStringLiteral("word"));
+
+        REQUIRE(repo->removeSetting(key));
+        REQUIRE(!repo->getSettingValue<QString>(key));
+        REQUIRE(!repo->removeSetting(key));
+
+        // Settings are served without going to the database
+        auto before = repo->getStatementCacheStats();
+        REQUIRE(repo->getClubName().isEmpty());
+        REQUIRE(repo->getLevelRange().isValid());
+        auto after = repo->getStatementCacheStats();
+        REQUIRE(after.hits + after.misses == before.hits + before.misses);
+    }
+
+    SECTION("statement cache") {
+        auto before = repo->getStatementCacheStats();
+        REQUIRE(!repo->getLastSession());
+        REQUIRE(!repo->getLastSession());
+        auto after = repo->getStatementCacheStats();
+        REQUIRE(after.hits + after.misses == before.hits + before.misses + 2);
+        REQUIRE(after.hits >= before.hits + 1);
+
+        repo->setStatementCacheEnabled(false);
+        REQUIRE(repo->getStatementCacheStats().numStatements == 0);
+        REQUIRE(!repo->getLastSession());
+        REQUIRE(repo->getStatementCacheStats().numStatements == 0);
+        REQUIRE(repo->getStatementCacheStats().hits == after.hits);
+    }
+
+    SECTION("statement cache keeps the recent statements only") {
+        auto session = repo->createSession(500, QStringLiteral("Place"), QString(), 4, {{"Court1", 1}});
+        REQUIRE(session);
+
+        // A game of each size has its own insert statement
+        const int numMembers = 100;
+        QVector<GameAllocation> allocations;
+        for (int i = 0; i < numMembers; i++) {
+            auto member = repo->createMember(QStringLiteral("First%1").arg(i), QStringLiteral("Last"),
+                                             BaseMember::Male, 1, "", "");
+            REQUIRE(member);
+            REQUIRE(repo->checkIn(session->session.id, member->id, false));
+            allocations.push_back(GameAllocation(0, session->courts[0].id, member->id, 50));
+            REQUIRE(repo->createGame(session->session.id, allocations, 900));
+        }
+        REQUIRE(repo->getStatementCacheStats().numStatements < numMembers);
+
+        auto before = repo->getStatementCacheStats();
+        REQUIRE(repo->getLastSession());
+        REQUIRE(repo->getLastSession());
+        REQUIRE(repo->getStatementCacheStats().hits >= before.hits + 1);
+    }
+
+    SECTION("change notifications") {
+        QSignalSpy flushSpy(repo.get(), &ClubRepository::changesFlushed);
+
+        auto session = repo->createSession(500, QStringLiteral("Place"), QString(), 4, {{"Court1", 1}});
+        REQUIRE(session);
+        const auto sessionId = session->session.id;
+
+        QVector<MemberId> memberIds;
+        for (int i = 0; i < 5; i++) {
+            auto m = repo->createMember(QStringLiteral("First%1").arg(i), QStringLiteral("Last"),
+                                        BaseMember::Male, 1, "", "");
+            REQUIRE(m);
+            REQUIRE(repo->checkIn(sessionId, m->id, false));
+            memberIds.push_back(m->id);
+        }
+        REQUIRE(repo->setPaid(sessionId, memberIds[0], true));
+
+        // Nothing goes out until the event loop gets to run
+        REQUIRE(flushSpy.isEmpty());
+        REQUIRE(flushSpy.wait(1000));
+        REQUIRE(flushSpy.size() == 1);
+
+        auto changes = flushSpy[0][0].value<ChangeSet>();
+        REQUIRE(changes.sessions == QSet<SessionId>{sessionId});
+        REQUIRE(changes.playerFlags == QSet<SessionId>{sessionId});
+        REQUIRE(changes.members);
+        REQUIRE(!changes.clubInfo);
+        REQUIRE(changes.affects(sessionId));
+
+        QSet<MemberId> createdIds;
+        for (auto id : memberIds) {
+            createdIds.insert(id);
+        }
+        REQUIRE(changes.memberIds == createdIds);
+        REQUIRE(!changes.allMembers);
+        REQUIRE(changes.affectsAnyMember(QSet<MemberId>{memberIds[2]}));
+        REQUIRE(!changes.affectsAnyMember(QSet<MemberId>{memberIds.last() + 1}));
+
+        auto stats = repo->getChangeNotificationStats();
+        REQUIRE(stats.numChanges == 12);
+        REQUIRE(stats.numFlushes == 1);
+        REQUIRE(stats.numAvoided() == 11);
+
+        REQUIRE(repo->saveClubName(QStringLiteral("Club")));
+        repo->flushChanges();
+        REQUIRE(flushSpy.size() == 2);
+        REQUIRE(flushSpy[1][0].value<ChangeSet>().clubInfo);
+
+        // Flushing with nothing pending stays quiet
+        repo->flushChanges();
+        REQUIRE(flushSpy.size() == 2);
+    }
+
+    SECTION("member search") {
+        auto john = repo->createMember(QStringLiteral("John"), QStringLiteral("Smith"), BaseMember::Male, 1,
+                                       QStringLiteral("0412 345 678"), QStringLiteral("jsmith@example.com"));
+        auto johanna = repo->createMember(QStringLiteral("Johanna"), QStringLiteral("Doe"), BaseMember::Female, 1,
+                                          QString(), QString());
+        auto mary = repo->createMember(QStringLiteral("Mary"), QStringLiteral("Johnson"), BaseMember::Female, 1,
+                                       QString(), QString());
+        REQUIRE(john);
+        REQUIRE(johanna);
+        REQUIRE(mary);
+
+        auto findIds = [&](const QString &needle) {
+            QVector<MemberId> ids;
+            for (const auto &m : repo->findMember(AllMembers{}, needle)) {
+                ids.push_back(m.id);
+            }
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+
+        REQUIRE(findIds(QStringLiteral("jo")) == QVector<MemberId>{john->id, johanna->id, mary->id});
+        REQUIRE(findIds(QStringLiteral("smi")) == QVector<MemberId>{john->id});
+        REQUIRE(findIds(QStringLiteral("0412")) == QVector<MemberId>{john->id});
+        REQUIRE(findIds(QStringLiteral("jsmith")) == QVector<MemberId>{john->id});
+        REQUIRE(findIds(QStringLiteral("jo  sm")) == QVector<MemberId>{john->id});
+        REQUIRE(findIds(QStringLiteral("\"jo")) == QVector<MemberId>{john->id, johanna->id, mary->id});
+        REQUIRE(findIds(QStringLiteral("nobody")).isEmpty());
+
+        auto renamed = *mary;
+        renamed.lastName = QStringLiteral("Brown");
+        REQUIRE(repo->saveMember(renamed));
+        REQUIRE(findIds(QStringLiteral("johns")).isEmpty());
+        REQUIRE(findIds(QStringLiteral("brow")) == QVector<MemberId>{mary->id});
+    }
+
     SECTION("member manipulation") {
         QVector<BaseMember> members(50);
         for (size_t i = 0, size = members.size(); i < size; i++) {
@@ -202,6 +405,50 @@ TEST_CASE("ClubRepository") {
         }
     }
 
+    SECTION("member import in chunks") {
+        REQUIRE(repo->createMember(QStringLiteral("First7"), QStringLiteral("Last7"), BaseMember::Male, 1, "", ""));
+
+        const int numMembers = 2500;
+        int i = 0;
+        auto supplier = [&](BaseMember &m) {
+            if (i >= numMembers) return false;
+            // Every hundredth name is the one before it in another case
+            const int n = (i % 100 == 99) ? i - 1 : i;
+            m.firstName = QStringLiteral("First%1").arg(n);
+            m.lastName = (n == i) ? QStringLiteral("Last%1").arg(n) : QStringLiteral(" LAST%1 ").arg(n);
+            m.gender = BaseMember::Female;
+            m.level = 2;
+            i++;
+            return true;
+        };
+
+        QVector<size_t> progress;
+        QVector<BaseMember> failed;
+        auto numImported = repo->importMembers(supplier, &failed, [&](size_t numRead) {
+            progress.push_back(numRead);
+            return true;
+        });
+
+        REQUIRE(failed.size() == 1 + numMembers / 100);
+        REQUIRE(numImported == numMembers - failed.size());
+        REQUIRE(repo->getMembers(AllMembers{}).size() == numImported + 1);
+        REQUIRE(progress == QVector<size_t>{1000, 2000});
+        REQUIRE(memberChangeSpy.size() == 2);
+
+        // Everything from a chunk that had gone in stays when the import is stopped
+        i = 0;
+        repo->importMembers([&](BaseMember &m) {
+            if (!supplier(m)) return false;
+            m.firstName = QStringLiteral("Again%1").arg(i);
+            return true;
+        }, nullptr, [](size_t) { return false; });
+        REQUIRE(i == 1000);
+        REQUIRE(repo->getMembers(AllMembers{}).size() == numImported + 1001);
+
+        // The duplication check is back in place afterwards
+        REQUIRE(!repo->createMember(QStringLiteral("first8"), QStringLiteral("last8"), BaseMember::Male, 1, "", ""));
+    }
+
     SECTION("session manipulation") {
         QVector<BaseMember> members;
         for (int i = 0; i < 11; i++) {
@@ -439,6 +686,45 @@ TEST_CASE("ClubRepository") {
                 }
             }
 
+            SECTION("Typed change signals") {
+                QSignalSpy paidSpy(repo.get(), &ClubRepository::paidChanged);
+                QSignalSpy pauseSpy(repo.get(), &ClubRepository::pauseChanged);
+                QSignalSpy checkInSpy(repo.get(), &ClubRepository::playerCheckedIn);
+                QSignalSpy checkOutSpy(repo.get(), &ClubRepository::playerCheckedOut);
+                QSignalSpy memberUpdateSpy(repo.get(), &ClubRepository::memberUpdated);
+
+                const auto memberId = checkedInMembers[0].first.id;
+                REQUIRE(repo->setPaid(sessionId, memberId, false));
+                REQUIRE(paidSpy.size() == 1);
+                REQUIRE(paidSpy[0] == QVariantList{sessionId, memberId, false});
+
+                REQUIRE(repo->setPaused(sessionId, memberId, true));
+                REQUIRE(pauseSpy.size() == 1);
+                REQUIRE(pauseSpy[0] == QVariantList{sessionId, memberId, true});
+
+                REQUIRE(repo->checkOut(sessionId, memberId));
+                REQUIRE(checkOutSpy.size() == 1);
+                REQUIRE(checkOutSpy[0] == QVariantList{sessionId, memberId});
+
+                REQUIRE(repo->checkIn(sessionId, members[1].id, true));
+                REQUIRE(checkInSpy.size() == 1);
+                REQUIRE(checkInSpy[0][0] == sessionId);
+                auto checkedIn = checkInSpy[0][1].value<Member>();
+                REQUIRE(checkedIn.id == members[1].id);
+                REQUIRE(checkedIn.status == Member::CheckedIn);
+                REQUIRE(checkedIn.paid == true);
+
+                auto renamed = members[1];
+                renamed.lastName = QStringLiteral("Renamed");
+                REQUIRE(repo->saveMember(renamed));
+                REQUIRE(memberUpdateSpy.size() == 1);
+                REQUIRE(memberUpdateSpy[0][0].value<BaseMember>() == renamed);
+
+                // Failed changes stay quiet
+                REQUIRE(!repo->setPaid(sessionId + 1, memberId, true));
+                REQUIRE(paidSpy.size() == 1);
+            }
+
             SECTION("Check in after check out") {
                 auto member = createMemberFrom(checkedOutMembers[0].first, Member::CheckedIn,
                                                checkedOutMembers[0].second);
@@ -496,8 +782,10 @@ TEST_CASE("ClubRepository") {
                                         },
                                 }));
 
+                QSignalSpy gameCreatedSpy(repo.get(), &ClubRepository::gameCreated);
                 auto gameId = repo->createGame(sessionId, allocations, duration);
                 REQUIRE(gameId.has_value() == successExpected);
+                REQUIRE(gameCreatedSpy.size() == (successExpected ? 1 : 0));
                 REQUIRE(sessionChangeSpy.size() == (successExpected ? 1 : 0));
                 sessionChangeSpy.clear();
                 if (!gameId) return;
@@ -520,6 +808,18 @@ TEST_CASE("ClubRepository") {
                     for (const auto &ga : allocations) {
                         REQUIRE(ga.memberId == pg.players[i++].id);
                     }
+
+                    // Stats already read follow the games created after
+                    REQUIRE(repo->createGame(sessionId, {GameAllocation(0, sessionData->courts[0].id,
+                                                                        checkedInMembers[1].first.id, 100)}, duration));
+                    REQUIRE(repo->getMemberGameStats(checkedInMembers[0].first.id, sessionId).numGamesOff == 1);
+                    REQUIRE(repo->getMemberGameStats(checkedInMembers[0].first.id, sessionId).pastGames.size() == 1);
+                    REQUIRE(repo->getMemberGameStats(checkedInMembers[1].first.id, sessionId).numGamesOff == 0);
+                    REQUIRE(repo->getMemberGameStats(checkedInMembers[1].first.id, sessionId).pastGames.size() == 2);
+
+                    // Checking in again starts the player over
+                    REQUIRE(repo->checkIn(sessionId, checkedInMembers[1].first.id, false));
+                    REQUIRE(repo->getMemberGameStats(checkedInMembers[1].first.id, sessionId).pastGames.isEmpty());
                 }
 
                 SECTION("getLastGameInfo should work") {
@@ -580,8 +880,121 @@ TEST_CASE("ClubRepository") {
                     REQUIRE(actual == expectedAllocations);
                 }
 
+                SECTION("getAllocationsSince should only return newer games") {
+                    REQUIRE(repo->getNumGames(sessionId) == 1);
+                    REQUIRE(repo->getAllocationsSince(sessionId, *gameId).isEmpty());
+                    REQUIRE(repo->getAllocationsSince(sessionId, std::nullopt).size() == allocations.size());
+
+                    auto newGameId = repo->createGame(sessionId, allocations, duration);
+                    REQUIRE(newGameId);
+                    REQUIRE(repo->getNumGames(sessionId) == 2);
+
+                    auto actual = repo->getAllocationsSince(sessionId, *gameId);
+                    REQUIRE(actual.size() == allocations.size());
+                    REQUIRE(std::all_of(actual.begin(), actual.end(), [&](const GameAllocation &ga) {
+                        return ga.gameId == *newGameId;
+                    }));
+                    REQUIRE(repo->getAllocationsSince(sessionId + 1, std::nullopt).isEmpty());
+                }
+
+                SECTION("getCoPlayHistory should follow created and withdrawn games") {
+                    auto history = repo->getCoPlayHistory();
+                    REQUIRE(history.size() == 6);
+                    REQUIRE(history.weight(allocations[0].memberId, allocations[1].memberId) == Approx(1.0).epsilon(0.01));
+                    REQUIRE(history.weight(allocations[3].memberId, allocations[2].memberId) == Approx(1.0).epsilon(0.01));
+                    REQUIRE(history.weight(allocations[0].memberId, members[10].id) == 0);
+                    REQUIRE(repo->getCoPlayHistory(sessionId).isEmpty());
+
+                    REQUIRE(repo->createGame(sessionId, allocations, duration));
+                    REQUIRE(repo->getCoPlayHistory().weight(allocations[0].memberId, allocations[1].memberId) ==
+                            Approx(2.0).epsilon(0.01));
+                    REQUIRE(repo->getCoPlayHistory(sessionId).isEmpty());
+                    REQUIRE(repo->getCoPlayHistory(sessionId + 1).size() == 6);
+
+                    REQUIRE(repo->withdrawLastGame(sessionId));
+                    REQUIRE(repo->withdrawLastGame(sessionId));
+                    REQUIRE(repo->getCoPlayHistory().isEmpty());
+                }
+
+                SECTION("Checking in again should take the player's games off the co-play history") {
+                    REQUIRE(repo->createGame(sessionId, allocations, duration));
+                    REQUIRE(repo->checkIn(sessionId, allocations[0].memberId, false));
+
+                    auto history = repo->getCoPlayHistory();
+                    REQUIRE(history.size() == 3);
+                    REQUIRE(history.weight(allocations[0].memberId, allocations[1].memberId) == 0);
+                    REQUIRE(history.weight(allocations[3].memberId, allocations[2].memberId) == Approx(2.0).epsilon(0.01));
+                    REQUIRE(repo->getPastAllocations(sessionId).size() == (allocations.size() - 1) * 2);
+
+                    REQUIRE(repo->withdrawLastGame(sessionId));
+                    REQUIRE(repo->withdrawLastGame(sessionId));
+                    REQUIRE(repo->getCoPlayHistory().isEmpty());
+                }
+
+                SECTION("replaceGameAllocations should work") {
+                    auto replaced = allocations;
+                    for (auto &ga : replaced) {
+                        ga.gameId = *gameId;
+                    }
+                    replaced[0].memberId = checkedInMembers[4].first.id;
+
+                    REQUIRE(repo->replaceGameAllocations(sessionId, *gameId, replaced));
+                    REQUIRE(sessionChangeSpy.size() == 1);
+
+                    auto actual = repo->getPastAllocations(sessionId);
+                    std::sort(actual.begin(), actual.end());
+                    std::sort(replaced.begin(), replaced.end());
+                    REQUIRE(actual == replaced);
+
+                    auto history = repo->getCoPlayHistory();
+                    REQUIRE(history.size() == 6);
+                    REQUIRE(history.weight(allocations[0].memberId, allocations[1].memberId) == 0);
+                    REQUIRE(history.weight(checkedInMembers[4].first.id, allocations[1].memberId) > 0);
+
+                    REQUIRE(!repo->replaceGameAllocations(sessionId + 1, *gameId, replaced));
+                    REQUIRE(!repo->replaceGameAllocations(sessionId, *gameId, {}));
+                }
+
+                SECTION("session snapshot should follow changes") {
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    REQUIRE(repo->setPaid(sessionId, checkedInMembers[1].first.id, true));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    REQUIRE(repo->setPaused(sessionId, checkedInMembers[0].first.id, true));
+                    REQUIRE(repo->setPaused(sessionId, checkedInMembers[1].first.id, false));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    auto renamed = checkedInMembers[2].first;
+                    renamed.firstName = checkedInMembers[3].first.firstName;
+                    REQUIRE(repo->saveMember(renamed));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    auto replaced = allocations;
+                    replaced[0].memberId = checkedInMembers[4].first.id;
+                    REQUIRE(repo->replaceGameAllocations(sessionId, *gameId, replaced));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    REQUIRE(repo->checkOut(sessionId, checkedInMembers[3].first.id));
+                    REQUIRE(repo->checkIn(sessionId, members[1].id, false));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    REQUIRE(repo->checkIn(sessionId, checkedOutMembers[0].first.id, true));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    REQUIRE(repo->createGame(sessionId, replaced, duration));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+
+                    REQUIRE(repo->withdrawLastGame(sessionId));
+                    REQUIRE(repo->withdrawLastGame(sessionId));
+                    requireSnapshotMatchesDatabase(*repo, sessionId);
+                }
+
                 SECTION("withdrawLastGame should work") {
+                    QSignalSpy gameWithdrawnSpy(repo.get(), &ClubRepository::gameWithdrawn);
                     REQUIRE(repo->withdrawLastGame(sessionId));
+                    REQUIRE(gameWithdrawnSpy.size() == 1);
+                    REQUIRE(gameWithdrawnSpy[0] == QVariantList{sessionId, *gameId});
                     auto lastGame = repo->getLastGameInfo(sessionId);
                     if (lastGame) {
                         REQUIRE(lastGame->id != gameId);
@@ -590,4 +1003,450 @@ TEST_CASE("ClubRepository") {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+// Tables that grow with every session, which a session scoped query must never walk in full
+static bool scansSessionTable(const QString &planLine) {
+    static const QRegularExpression scan(QStringLiteral("^SCAN (TABLE )?(\\w+)( AS (\\w+))?"));
+    auto match = scan.match(planLine);
+    if (!match.hasMatch()) return false;
+
+    auto name = (match.captured(4).isEmpty() ? match.captured(2) : match.captured(4)).toLower();
+    return name == QStringLiteral("players") || name == QStringLiteral("p") ||
+           name == QStringLiteral("sessions") || name == QStringLiteral("s");
+}
+
+TEST_CASE("ClubRepository query plans") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    auto session = repo->createSession(500, QStringLiteral("Place"), QString(), 4, {{"Court1", 1}});
+    REQUIRE(session);
+    const auto sessionId = session->session.id;
+
+    auto filter = GENERATE_COPY(values<MemberSearchFilter>(
+            {
+                    NonCheckedIn{sessionId},
+                    CheckedIn{sessionId},
+                    CheckedIn{sessionId, true},
+                    CheckedIn{sessionId, false},
+                    AllSession{sessionId},
+            }));
+
+    auto plan = repo->getMembersQueryPlan(filter);
+    INFO(plan.join(QStringLiteral("\n")).toStdString());
+    REQUIRE(!plan.isEmpty());
+    REQUIRE(std::none_of(plan.begin(), plan.end(), scansSessionTable));
+
+    // Listing checked in players starts from the session's players, not every member
+    if (!std::get_if<NonCheckedIn>(&filter)) {
+        REQUIRE(std::none_of(plan.begin(), plan.end(), [](const QString &line) {
+            return line.startsWith(QStringLiteral("SCAN"));
+        }));
+    }
+
+    // Players are always looked up by their session
+    REQUIRE(std::any_of(plan.begin(), plan.end(), [](const QString &line) {
+        return line.startsWith(QStringLiteral("SEARCH")) && line.contains(QStringLiteral("sessionId=?"));
+    }));
+}
+
+TEST_CASE("ClubRepository async reads") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    auto inMemory = GENERATE(true, false);
+    std::unique_ptr<ClubRepository> repo(
+            ClubRepository::open(nullptr, inMemory ? QStringLiteral(":memory:") : dir.filePath(QStringLiteral("club.db"))));
+    REQUIRE(repo);
+    REQUIRE(repo->createMember(QStringLiteral("First"), QStringLiteral("Last"), BaseMember::Male, 1, "", ""));
+
+    auto future = repo->readAsync([](const ClubRepository &r) {
+        return std::make_pair(r.getMembers(AllMembers{}).size(), QThread::currentThread());
+    });
+    auto[numMembers, thread] = future.result();
+    REQUIRE(numMembers == 1);
+    REQUIRE((thread == QThread::currentThread()) == inMemory);
+
+    // Written after the first read, which the reader has to see too
+    REQUIRE(repo->createMember(QStringLiteral("Second"), QStringLiteral("Last"), BaseMember::Male, 1, "", ""));
+
+    std::optional<int> result;
+    QObject context;
+    repo->readAsync([](const ClubRepository &r) {
+        return r.getMembers(AllMembers{}).size();
+    }, &context, [&](int size) {
+        REQUIRE(QThread::currentThread() == context.thread());
+        result = size;
+    });
+    REQUIRE(QTest::qWaitFor([&] { return result.has_value(); }, 1000));
+    REQUIRE(*result == 2);
+}
+
+TEST_CASE("ClubRepository thread readers") {
+    SECTION("Repositories keep their own connections") {
+        std::unique_ptr<ClubRepository> first(ClubRepository::open(nullptr, ":memory:"));
+        std::unique_ptr<ClubRepository> second(ClubRepository::open(nullptr, ":memory:"));
+        REQUIRE(first);
+        REQUIRE(second);
+        REQUIRE(first->createMember(QStringLiteral("First"), QStringLiteral("Last"), BaseMember::Male, 1, "", ""));
+        REQUIRE(first->getMembers(AllMembers{}).size() == 1);
+        REQUIRE(second->getMembers(AllMembers{}).isEmpty());
+
+        REQUIRE(!first->canReadOnAnyThread());
+        REQUIRE(first->readerForCurrentThread() == first.get());
+        REQUIRE(QtConcurrent::run([&] { return first->readerForCurrentThread(); }).result() == nullptr);
+    }
+
+    SECTION("Every worker thread reads on its own connection") {
+        QTemporaryDir dir;
+        REQUIRE(dir.isValid());
+
+        std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, dir.filePath(QStringLiteral("club.db"))));
+        REQUIRE(repo);
+        REQUIRE(repo->canReadOnAnyThread());
+        REQUIRE(repo->readerForCurrentThread() == repo.get());
+        REQUIRE(repo->createMember(QStringLiteral("First"), QStringLiteral("Last"), BaseMember::Male, 1, "", ""));
+
+        QThreadPool pool;
+        pool.setMaxThreadCount(4);
+
+        QVector<QFuture<std::pair<const ClubRepository *, int>>> futures;
+        for (int i = 0; i < 16; i++) {
+            futures.push_back(QtConcurrent::run(&pool, [&] {
+                auto reader = repo->readerForCurrentThread();
+                auto again = repo->readerForCurrentThread();
+                return std::make_pair(reader == again ? reader : nullptr,
+                                      reader ? reader->getMembers(AllMembers{}).size() : -1);
+            }));
+        }
+
+        QSet<const ClubRepository *> readers;
+        for (auto &future : futures) {
+            auto[reader, numMembers] = future.result();
+            REQUIRE(reader);
+            REQUIRE(reader != repo.get());
+            REQUIRE(numMembers == 1);
+            readers.insert(reader);
+        }
+        REQUIRE(readers.size() <= 4);
+    }
+
+    SECTION("Readers of running threads are closed when their threads finish") {
+        QTemporaryDir dir;
+        REQUIRE(dir.isValid());
+
+        const auto numConnections = QSqlDatabase::connectionNames().size();
+        {
+            QThreadPool pool;
+            {
+                std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, dir.filePath(QStringLiteral("club.db"))));
+                REQUIRE(repo);
+                REQUIRE(QtConcurrent::run(&pool, [&] { return repo->readerForCurrentThread() != nullptr; }).result());
+            }
+
+            // Still open on the pool thread, which nothing closes it from but itself
+            REQUIRE(QSqlDatabase::connectionNames().size() == numConnections + 1);
+        }
+        REQUIRE(QSqlDatabase::connectionNames().size() == numConnections);
+    }
+}
+
+TEST_CASE("ClubRepository session archive") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    auto inMemory = GENERATE(true, false);
+    const auto path = inMemory ? QStringLiteral(":memory:") : dir.filePath(QStringLiteral("club.db"));
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, path));
+    REQUIRE(repo);
+
+    auto member = repo->createMember(QStringLiteral("First"), QStringLiteral("Last"), BaseMember::Male, 1, "", "");
+    REQUIRE(member);
+
+    QSet<SessionId> sessionIds;
+    for (int i = 0; i < 3; i++) {
+        auto session = repo->createSession(500, QStringLiteral("Place"), QString(), 4, {{"Court1", 1}});
+        REQUIRE(session);
+        REQUIRE(repo->checkIn(session->session.id, member->id, i % 2 == 0));
+        REQUIRE(repo->createGame(session->session.id,
+                                 {GameAllocation(0, session->courts[0].id, member->id, 50)}, 900));
+        sessionIds.insert(session->session.id);
+    }
+    const auto lastSession = repo->getLastSession();
+    REQUIRE(lastSession);
+
+    auto paymentRecords = repo->getPaymentRecords(sessionIds);
+    REQUIRE(paymentRecords.size() == 3);
+    for (const auto &record : paymentRecords) {
+        REQUIRE(sessionIds.contains(record.sessionId));
+        REQUIRE(record.memberId == member->id);
+        REQUIRE(record.memberFirstName == member->firstName);
+        REQUIRE(record.sessionStartTime > 0);
+    }
+    REQUIRE(repo->getPaymentRecords({}).isEmpty());
+    REQUIRE(repo->getPaymentRecords({*repo->getLastSession()}).size() == 1);
+
+    int numStreamed = 0;
+    REQUIRE(repo->forEachPaymentRecord(sessionIds, [&](const PaymentRecord &) { return ++numStreamed < 2; }));
+    REQUIRE(numStreamed == 2);
+
+    if (!inMemory) {
+        // No archive file until archiving is turned on and the club opened again
+        const auto archivePath = path + QStringLiteral(".archive");
+        REQUIRE(!QFile::exists(archivePath));
+        REQUIRE(!repo->archiveSessions(QDateTime::currentDateTimeUtc().addDays(1)));
+        REQUIRE(repo->runMaintenance());
+        REQUIRE(repo->getAllSessions().size() == 3);
+        REQUIRE(repo->getPaymentRecords(sessionIds).size() == 3);
+
+        REQUIRE(repo->saveSetting(QStringLiteral("archive_after_months"), 12));
+        REQUIRE(!QFile::exists(archivePath));
+        repo.reset(ClubRepository::open(nullptr, path));
+        REQUIRE(repo);
+        REQUIRE(QFile::exists(archivePath));
+    }
+
+    REQUIRE(repo->archiveSessions(QDateTime::currentDateTimeUtc().addDays(-1)) == 0);
+    REQUIRE(repo->archiveSessions(QDateTime::currentDateTimeUtc().addDays(1)) == 2);
+    REQUIRE(repo->archiveSessions(QDateTime::currentDateTimeUtc().addDays(1)) == 0);
+
+    // Only the last session is left in the club itself, reports still see them all
+    for (auto id : sessionIds) {
+        REQUIRE(repo->getSession(id).has_value() == (id == *lastSession));
+    }
+    REQUIRE(repo->getLastSession() == lastSession);
+    REQUIRE(repo->getAllSessions().size() == 3);
+    REQUIRE(repo->getPaymentRecords(sessionIds).size() == 3);
+    REQUIRE(repo->getMembers(CheckedIn{*lastSession}).size() == 1);
+
+    REQUIRE(repo->runMaintenance());
+    REQUIRE(repo->getAllSessions().size() == 3);
+
+    bool maintained = false;
+    QEventLoop loop;
+    QTimer::singleShot(10000, &loop, &QEventLoop::quit);
+    repo->runMaintenanceAsync(&loop, [&](bool ok) {
+        maintained = ok;
+        loop.quit();
+    });
+    if (!inMemory) loop.exec();
+    REQUIRE(maintained);
+    REQUIRE(repo->getAllSessions().size() == 3);
+
+    if (!inMemory) {
+        auto records = repo->readAsync([=](const ClubRepository &r) {
+            return r.getPaymentRecords(sessionIds).size();
+        });
+        REQUIRE(records.result() == 3);
+
+        repo.reset(ClubRepository::open(nullptr, path));
+        REQUIRE(repo);
+        REQUIRE(repo->getAllSessions().size() == 3);
+        REQUIRE(repo->getPaymentRecords(sessionIds).size() == 3);
+
+        // An archive stopped after its copy went in leaves the last session in both files
+        REQUIRE(repo->createSession(500, QStringLiteral("Place"), QString(), 4, {{"Court1", 1}}));
+        repo.reset();
+        {
+            auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("interrupted_archive"));
+            db.setDatabaseName(path + QStringLiteral(".archive"));
+            REQUIRE(db.open());
+
+            QSqlQuery q(db);
+            q.prepare(QStringLiteral("attach database ? as club"));
+            q.addBindValue(path);
+            REQUIRE(q.exec());
+
+            const QString sqls[] = {
+                    QStringLiteral("insert into sessions select id, startTime, fee, numPlayersPerCourt, place, announcement "
+                                   "from club.sessions where id = ?"),
+                    QStringLiteral("insert into courts select id, sessionId, name, sortOrder from club.courts where sessionId = ?"),
+                    QStringLiteral("insert into players select id, sessionId, memberId, paid, checkInTime, checkOutTime, paused "
+                                   "from club.players where sessionId = ?"),
+                    QStringLiteral("insert into games select id, sessionId, startTime, durationSeconds "
+                                   "from club.games where sessionId = ?"),
+                    QStringLiteral("insert into game_allocations select GA.gameId, GA.courtId, GA.playerId, GA.quality "
+                                   "from club.game_allocations GA inner join club.games G on G.id = GA.gameId "
+                                   "where G.sessionId = ?"),
+            };
+            for (const auto &sql : sqls) {
+                q.prepare(sql);
+                q.addBindValue(*lastSession);
+                REQUIRE(q.exec());
+            }
+            q.finish();
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(QStringLiteral("interrupted_archive"));
+
+        repo.reset(ClubRepository::open(nullptr, path));
+        REQUIRE(repo);
+        REQUIRE(!repo->getSession(*lastSession));
+        REQUIRE(repo->getAllSessions().size() == 4);
+        REQUIRE(repo->getPaymentRecords(sessionIds).size() == 3);
+        REQUIRE(repo->archiveSessions(QDateTime::currentDateTimeUtc().addDays(1)) == 0);
+    }
+}
+
+TEST_CASE("ClubRepository player counters") {
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+    REQUIRE(repo);
+
+    auto session = repo->createSession(500, QStringLiteral("Place"), QString(), 2, {{"Court1", 1}, {"Court2", 2}});
+    REQUIRE(session);
+    const auto sessionId = session->session.id;
+
+    QVector<MemberId> memberIds;
+    for (int i = 0; i < 7; i++) {
+        auto member = repo->createMember(QStringLiteral("First%1").arg(i), QStringLiteral("Last%1").arg(i),
+                                         BaseMember::Female, 1, "", "");
+        REQUIRE(member);
+        REQUIRE(repo->checkIn(sessionId, member->id, false));
+        memberIds.push_back(member->id);
+    }
+
+    auto requireCountersMatchAllocations = [&] {
+        auto allocations = repo->getPastAllocations(sessionId);
+        GameStatsImpl stats(allocations);
+        auto counters = repo->getPlayerCounters(sessionId);
+        REQUIRE(counters.size() == memberIds.size());
+        for (auto memberId : memberIds) {
+            const auto &c = counters[memberId];
+            REQUIRE(c.gamesPlayed == stats.numGamesFor(memberId));
+            REQUIRE(c.numGamesOff == stats.numGamesOff(memberId));
+
+            std::optional<GameId> lastGameId;
+            for (const auto &allocation : allocations) {
+                if (allocation.memberId == memberId) lastGameId = allocation.gameId;
+            }
+            REQUIRE(c.lastGameId == lastGameId);
+            REQUIRE((c.lastPlayedAt > 0) == lastGameId.has_value());
+        }
+    };
+
+    requireCountersMatchAllocations();
+
+    // Four of the seven play each game, starting one further along every time
+    auto gameOf = [&](int start) {
+        QVector<GameAllocation> allocations;
+        for (int i = 0; i < 4; i++) {
+            allocations.push_back(GameAllocation(0, session->courts[i / 2].id,
+                                                 memberIds[(start + i) % memberIds.size()], 50));
+        }
+        return allocations;
+    };
+
+    for (int i = 0; i < 5; i++) {
+        auto gameId = repo->createGame(sessionId, gameOf(i), 900);
+        REQUIRE(gameId);
+        requireCountersMatchAllocations();
+
+        if (i == 2) {
+            REQUIRE(repo->replaceGameAllocations(sessionId, *gameId, gameOf(i + 3)));
+            requireCountersMatchAllocations();
+        }
+    }
+
+    REQUIRE(repo->withdrawLastGame(sessionId));
+    requireCountersMatchAllocations();
+    REQUIRE(repo->withdrawLastGame(sessionId));
+    requireCountersMatchAllocations();
+
+    auto stats = repo->getMemberGameStats(memberIds[0], sessionId);
+    REQUIRE(stats.numGamesOff == static_cast<size_t>(repo->getNumGames(sessionId) - stats.pastGames.size()));
+}
+
+static QString journalModeOf(const QString &path) {
+    QString mode;
+    {
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("journal_mode_check"));
+        db.setDatabaseName(path);
+        if (db.open()) {
+            QSqlQuery q(db);
+            if (q.exec(QStringLiteral("pragma journal_mode")) && q.next()) mode = q.value(0).toString();
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("journal_mode_check"));
+    return mode.toLower();
+}
+
+TEST_CASE("ClubRepository database profile") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const auto path = dir.filePath(QStringLiteral("club.db"));
+
+    auto [profile, expectedJournalMode] = GENERATE(table<DatabaseProfile, QString>(
+            {
+                    {DatabaseProfile(), "wal"},
+                    {DatabaseProfile::sqliteDefaults(), "delete"},
+            }));
+
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, path, profile));
+    REQUIRE(repo);
+    REQUIRE(repo->saveClubName(QStringLiteral("Club")));
+    REQUIRE(journalModeOf(path) == expectedJournalMode);
+    REQUIRE(repo->getClubName() == QStringLiteral("Club"));
+}
+
+static bool applySchemaFile(QSqlDatabase &db, int version) {
+    QFile file(QStringLiteral(":/sql/db_v%1.sql").arg(version));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QSqlQuery q(db);
+    for (auto sql : QString::fromUtf8(file.readAll()).split(QStringLiteral("---"))) {
+        sql = sql.trimmed();
+        if (!sql.isEmpty() && !q.exec(sql)) return false;
+    }
+    return true;
+}
+
+TEST_CASE("ClubRepository renames duplicate members when migrating") {
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const auto path = dir.filePath(QStringLiteral("club.db"));
+
+    // A v8 club with names that only differ in case and spacing, which went in before v3 checked for them
+    {
+        auto db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("v8_club"));
+        db.setDatabaseName(path);
+        REQUIRE(db.open());
+        REQUIRE(applySchemaFile(db, 1));
+        REQUIRE(applySchemaFile(db, 2));
+
+        const std::pair<QString, QString> names[] = {
+                {"John", "Smith"},
+                {"john", "SMITH"},
+                {" John ", "Smith "},
+                {"Jane", "Smith"},
+        };
+        QSqlQuery q(db);
+        for (const auto &[firstName, lastName] : names) {
+            q.prepare(QStringLiteral("insert into members (firstName, lastName, gender, level) values (?, ?, 'male', 1)"));
+            q.addBindValue(firstName);
+            q.addBindValue(lastName);
+            REQUIRE(q.exec());
+        }
+
+        for (int version = 3; version <= 8; version++) {
+            REQUIRE(applySchemaFile(db, version));
+        }
+        q.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("v8_club"));
+
+    std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, path));
+    REQUIRE(repo);
+
+    // The first of each name keeps it, the later ones get their id added
+    REQUIRE(repo->getMember(1)->lastName == QStringLiteral("Smith"));
+    REQUIRE(repo->getMember(2)->lastName == QStringLiteral("SMITH (2)"));
+    REQUIRE(repo->getMember(3)->lastName == QStringLiteral("Smith  (3)"));
+    REQUIRE(repo->getMember(4)->lastName == QStringLiteral("Smith"));
+
+    REQUIRE(!repo->createMember(QStringLiteral("JOHN"), QStringLiteral("smith"), BaseMember::Male, 1, "", ""));
+    REQUIRE(!repo->createMember(QStringLiteral("jane"), QStringLiteral(" Smith"), BaseMember::Female, 1, "", ""));
+    REQUIRE(repo->createMember(QStringLiteral("John"), QStringLiteral("Smithers"), BaseMember::Male, 1, "", ""));
+}
@@ -35,6 +35,7 @@ TEST_CASE("EmptySessionPage") {
         QSignalSpy spy(&page, &EmptySessionPage::lastSessionResumed);
 
         REQUIRE(repo->createSession(500, "", "", 4, {{"Name1", 1}}));
+        repo->flushChanges();
         REQUIRE(resumeButton->isEnabled());
         resumeButton->click();
         CHECK(spy.size() == 1);
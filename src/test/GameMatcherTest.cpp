@@ -0,0 +1,147 @@
+#include <catch2/catch.hpp>
+
+#include "GameMatcher.h"
+#include "CoPlayHistory.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+
+static QVector<Member> availableMembers(std::initializer_list<MemberId> ids) {
+    QVector<Member> members;
+    for (auto id : ids) {
+        auto m = createMember("First", "Last", (id % 2 == 0) ? Member::Male : Member::Female, 1 + (id % 3));
+        m.id = id;
+        members.push_back(m);
+    }
+    return members;
+}
+
+static QVector<MemberId> playersOnCourt(const QVector<GameAllocation> &allocations, CourtId courtId) {
+    QVector<MemberId> ids;
+    for (const auto &allocation : allocations) {
+        if (allocation.courtId == courtId) ids.push_back(allocation.memberId);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+TEST_CASE("GameMatcher::repair") {
+    const GameId lastGameId = 2;
+    const QVector<CourtId> courtIds = {1, 2, 3};
+
+    QVector<GameAllocation> currentGame;
+    for (MemberId id = 1; id <= 8; id++) {
+        currentGame.push_back(GameAllocation(lastGameId, id <= 4 ? 1 : 2, id, 50));
+    }
+
+    // Past allocations include the current game, the way the repository returns them
+    auto pastAllocations = currentGame;
+    for (MemberId id = 3; id <= 10; id++) {
+        pastAllocations.push_back(GameAllocation(1, id <= 6 ? 1 : 2, id, 50));
+    }
+
+    SECTION("Game stays the same when nobody has left") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}), courtIds, 4);
+        REQUIRE(playersOnCourt(result, 1) == QVector<MemberId>{1, 2, 3, 4});
+        REQUIRE(playersOnCourt(result, 2) == QVector<MemberId>{5, 6, 7, 8});
+    }
+
+    SECTION("Vacated seat goes to the longest waiting player") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 3, 4, 5, 6, 7, 8, 9, 10, 11}), courtIds, 4);
+        REQUIRE(result.size() == 8);
+        REQUIRE(std::all_of(result.begin(), result.end(), [=](const GameAllocation &a) {
+            return a.gameId == lastGameId;
+        }));
+        REQUIRE(playersOnCourt(result, 1) == QVector<MemberId>{1, 3, 4, 11});
+        REQUIRE(playersOnCourt(result, 2) == QVector<MemberId>{5, 6, 7, 8});
+    }
+
+    SECTION("Vacated seat is filled from the bench") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 3, 4, 5, 6, 7, 8, 9, 10}), courtIds, 4);
+        auto court1 = playersOnCourt(result, 1);
+        REQUIRE(court1.size() == 4);
+        REQUIRE(court1.mid(0, 3) == QVector<MemberId>{1, 3, 4});
+        REQUIRE((court1[3] == 9 || court1[3] == 10));
+        REQUIRE(playersOnCourt(result, 2) == QVector<MemberId>{5, 6, 7, 8});
+    }
+
+    SECTION("Court is released when the bench can't fill it") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 4, 5, 6, 7, 8, 9}), courtIds, 4);
+        REQUIRE(playersOnCourt(result, 1).isEmpty());
+        REQUIRE(playersOnCourt(result, 2) == QVector<MemberId>{5, 6, 7, 8});
+    }
+
+    SECTION("Players who joined get a free court once there are enough of them") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}), courtIds, 4);
+        REQUIRE(playersOnCourt(result, 1) == QVector<MemberId>{1, 2, 3, 4});
+        REQUIRE(playersOnCourt(result, 2) == QVector<MemberId>{5, 6, 7, 8});
+
+        auto court3 = playersOnCourt(result, 3);
+        REQUIRE(court3.size() == 4);
+        REQUIRE(court3.mid(1) == QVector<MemberId>{11, 12, 13});
+        REQUIRE((court3[0] == 9 || court3[0] == 10));
+    }
+
+    SECTION("Players who joined wait when there aren't enough for a court") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 2, 3, 4, 5, 6, 7, 8, 11}), courtIds, 4);
+        REQUIRE(result.size() == 8);
+        REQUIRE(playersOnCourt(result, 3).isEmpty());
+    }
+
+    SECTION("Players who joined take vacated seats before opening a court") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 3, 4, 5, 6, 7, 8, 11, 12, 13, 14}), courtIds, 4);
+        auto court1 = playersOnCourt(result, 1);
+        REQUIRE(court1.size() == 4);
+        REQUIRE(court1.mid(0, 3) == QVector<MemberId>{1, 3, 4});
+        REQUIRE(court1[3] >= 11);
+        REQUIRE(playersOnCourt(result, 3).isEmpty());
+    }
+
+    SECTION("Only the courts the game was made with are opened") {
+        auto result = GameMatcher::repair(pastAllocations, currentGame,
+                                          availableMembers({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}),
+                                          QVector<CourtId>{1, 2}, 4);
+        REQUIRE(result.size() == 8);
+        REQUIRE(playersOnCourt(result, 1) == QVector<MemberId>{1, 2, 3, 4});
+        REQUIRE(playersOnCourt(result, 2) == QVector<MemberId>{5, 6, 7, 8});
+        REQUIRE(playersOnCourt(result, 3).isEmpty());
+    }
+
+    SECTION("Nothing to repair without a game") {
+        REQUIRE(GameMatcher::repair(pastAllocations, {}, availableMembers({1, 2, 3, 4}), courtIds, 4).isEmpty());
+    }
+}
+
+TEST_CASE("GameMatcher::match") {
+    QVector<Member> members;
+    for (MemberId id = 1; id <= 8; id++) {
+        auto m = createMember("First", "Last", Member::Male, 2);
+        m.id = id;
+        members.push_back(m);
+    }
+
+    // Members 1 to 4 have often played together in earlier sessions, as have 5 to 8
+    CoPlayHistory history;
+    for (MemberId a = 1; a <= 8; a++) {
+        for (MemberId b = a + 1; b <= 8; b++) {
+            if ((a <= 4) == (b <= 4)) history.insert(CoPlayHistory::pairKey(a, b), 4);
+        }
+    }
+
+    SECTION("First game of a session splits up members who played together before") {
+        auto seed = GENERATE(range(0, 10));
+        auto result = GameMatcher::match({}, members, {1, 2}, 4, seed, &history);
+        REQUIRE(result.size() == 8);
+        for (CourtId courtId : {1, 2}) {
+            auto players = playersOnCourt(result, courtId);
+            REQUIRE(std::count_if(players.begin(), players.end(), [](MemberId id) { return id <= 4; }) == 2);
+        }
+    }
+}
@@ -74,4 +74,17 @@ TEST_CASE("GameStatsImplTest") {
         REQUIRE(stats.similarityScore(members) == expected);
     }
     REQUIRE(stats.numGames() == totalGame);
-}
\ No newline at end of file
+}
+
+TEST_CASE("GameStatsImpl with co-play history") {
+    CoPlayHistory history;
+    history.insert(CoPlayHistory::pairKey(2, 1), 4);
+
+    GameStatsImpl stats(QVector<GameAllocation>{});
+    REQUIRE(stats.similarityScore({1, 2}) == 0);
+
+    stats.setCoPlayHistory(&history);
+    REQUIRE(stats.similarityScore({1, 2}) == 50);
+    REQUIRE(stats.similarityScore({1, 3}) == 0);
+    REQUIRE(stats.similarityScore({1, 2, 3, 4}) == 8);
+}
@@ -0,0 +1,74 @@
+#include <catch2/catch.hpp>
+
+#include "MemberSearchIndex.h"
+
+static Member searchMember(MemberId id, const char *firstName, const char *lastName) {
+    Member m;
+    m.id = id;
+    m.firstName = QString::fromUtf8(firstName);
+    m.lastName = QString::fromUtf8(lastName);
+    return m;
+}
+
+static QVector<MemberId> idsOf(const QVector<Member> &members) {
+    QVector<MemberId> ids;
+    for (const auto &m : members) {
+        ids.push_back(m.id);
+    }
+    return ids;
+}
+
+TEST_CASE("MemberSearchIndex") {
+    MemberSearchIndex index({
+                                    searchMember(1, "John", "Smith"),
+                                    searchMember(2, "Mary", "Johnson"),
+                                    searchMember(3, "José", "Álvarez"),
+                                    searchMember(4, "Anna", "Jones"),
+                            });
+
+    SECTION("Blank needle lists everyone in name order") {
+        REQUIRE(idsOf(index.search(QString())) == QVector<MemberId>{4, 1, 3, 2});
+        REQUIRE(idsOf(index.search(QStringLiteral("   "))) == QVector<MemberId>{4, 1, 3, 2});
+    }
+
+    SECTION("Matches every word of multi-word names") {
+        index.upsert(searchMember(5, "Mary Ann", "Van Der Berg"));
+        REQUIRE(idsOf(index.search(QStringLiteral("mary ann"))) == QVector<MemberId>{5});
+        REQUIRE(idsOf(index.search(QStringLiteral("ann"))) == QVector<MemberId>{4, 5});
+        REQUIRE(idsOf(index.search(QStringLiteral("berg"))) == QVector<MemberId>{5});
+        REQUIRE(idsOf(index.search(QStringLiteral("mv"))) == QVector<MemberId>{5});
+    }
+
+    SECTION("Matches prefixes of first names, last names and initials") {
+        auto[needle, expected] = GENERATE(table<QString, QVector<MemberId>>(
+                {
+                        {"jo", {4, 1, 3, 2}},
+                        {"JOHN", {1, 2}},
+                        {"smi", {1}},
+                        {"js", {1}},
+                        {"aj", {4}},
+                        {"jose", {3}},
+                        {"alv", {3}},
+                        {"jo sm", {1}},
+                        {"sm jo", {1}},
+                        {"jo  x", {}},
+                        {"mith", {}},
+                }));
+
+        REQUIRE(idsOf(index.search(needle)) == expected);
+    }
+
+    SECTION("Follows changes") {
+        auto renamed = searchMember(2, "Mary", "Brown");
+        index.upsert(renamed);
+        REQUIRE(idsOf(index.search(QStringLiteral("johns"))).isEmpty());
+        REQUIRE(idsOf(index.search(QStringLiteral("bro"))) == QVector<MemberId>{2});
+
+        index.upsert(searchMember(5, "Bob", "Johnson"));
+        REQUIRE(idsOf(index.search(QStringLiteral("b"))) == QVector<MemberId>{5, 2});
+
+        index.remove(1);
+        REQUIRE(idsOf(index.search(QStringLiteral("jo"))) == QVector<MemberId>{4, 5, 3});
+        REQUIRE(index.members().size() == 4);
+    }
+}
@@ -0,0 +1,120 @@
+#include <catch2/catch.hpp>
+
+#include "QueryProfiler.h"
+#include "ClubRepository.h"
+
+#include <memory>
+
+static QueryProfiler::Sample sample(const QString &sql, qint64 elapsedUs, int numRows = 1) {
+    QueryProfiler::Sample s;
+    s.sql = sql;
+    s.elapsedUs = elapsedUs;
+    s.numRows = numRows;
+    return s;
+}
+
+TEST_CASE("QueryProfiler") {
+    auto &profiler = QueryProfiler::instance();
+    profiler.clear();
+    const auto slowThresholdMs = profiler.slowThresholdMs();
+
+    SECTION("Recent samples wrap around") {
+        for (int i = 0; i < QueryProfiler::capacity + 10; i++) {
+            profiler.record(sample(QString("select %1").arg(i), 1));
+        }
+
+        auto samples = profiler.recentSamples();
+        REQUIRE(samples.size() == QueryProfiler::capacity);
+        REQUIRE(samples.first().sql == QString("select 10"));
+        REQUIRE(samples.last().sql == QString("select %1").arg(QueryProfiler::capacity + 9));
+    }
+
+    SECTION("Top queries are ordered by total time") {
+        profiler.record(sample("select a", 100, 2));
+        profiler.record(sample("select b", 250, 1));
+        profiler.record(sample("select a", 200, 3));
+        profiler.record(sample("select c", 10, -1));
+
+        auto top = profiler.topQueries(2);
+        REQUIRE(top.size() == 2);
+        REQUIRE(top[0].sql == QString("select a"));
+        REQUIRE(top[0].numCalls == 2);
+        REQUIRE(top[0].totalUs == 300);
+        REQUIRE(top[0].maxUs == 200);
+        REQUIRE(top[0].numRows == 5);
+        REQUIRE(top[1].sql == QString("select b"));
+        REQUIRE(profiler.topQueries(-1).size() == 3);
+    }
+
+    SECTION("Only queries over the threshold are slow") {
+        profiler.setSlowThresholdMs(5);
+        profiler.record(sample("select fast", 4999));
+        profiler.record(sample("select slow", 5000));
+
+        auto slow = profiler.slowSamples();
+        REQUIRE(slow.size() == 1);
+        REQUIRE(slow.first().sql == QString("select slow"));
+    }
+
+    SECTION("Nested scopes are recorded once") {
+        {
+            const auto outer = QString("select outer");
+            QueryProfiler::Scope scope(outer, 2);
+            scope.setNumRows(7);
+
+            const auto inner = QString("select inner");
+            QueryProfiler::Scope nested(inner, 1);
+        }
+
+        auto samples = profiler.recentSamples();
+        REQUIRE(samples.size() == 1);
+        REQUIRE(samples.first().sql == QString("select outer"));
+        REQUIRE(samples.first().numParams == 2);
+        REQUIRE(samples.first().numRows == 7);
+    }
+
+    SECTION("Repository queries are recorded with their rows") {
+        std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+        REQUIRE(repo);
+        REQUIRE(repo->createSession(10, "Place", "Announcement", 4, {{"Court 1", 0}}));
+        REQUIRE(repo->createSession(10, "Place", "Announcement", 4, {{"Court 1", 0}}));
+
+        profiler.clear();
+        REQUIRE(repo->getAllSessions().size() == 2);
+
+        auto samples = profiler.recentSamples();
+        REQUIRE(samples.size() == 1);
+        REQUIRE(samples.first().sql.contains("from all_sessions"));
+        REQUIRE(samples.first().numParams == 0);
+        REQUIRE(samples.first().numRows == 2);
+
+        profiler.setEnabled(false);
+        repo->getAllSessions();
+        profiler.setEnabled(true);
+        REQUIRE(profiler.recentSamples().size() == 1);
+    }
+
+    SECTION("Queries read row by row are timed to the last row") {
+        std::unique_ptr<ClubRepository> repo(ClubRepository::open(nullptr, ":memory:"));
+        REQUIRE(repo);
+        auto session = repo->createSession(10, "Place", "Announcement", 4, {{"Court 1", 0}});
+        REQUIRE(session);
+        for (int i = 0; i < 3; i++) {
+            auto member = repo->createMember(QString("First%1").arg(i), "Last", BaseMember::Male, 1, "", "");
+            REQUIRE(member);
+            REQUIRE(repo->checkIn(session->session.id, member->id, false));
+        }
+
+        profiler.clear();
+        REQUIRE(repo->getPlayerCounters(session->session.id).size() == 3);
+
+        auto samples = profiler.recentSamples();
+        REQUIRE(samples.size() == 1);
+        REQUIRE(samples.first().sql.contains("from players P"));
+        REQUIRE(samples.first().numParams == 1);
+        REQUIRE(samples.first().numRows == 3);
+    }
+
+    profiler.setSlowThresholdMs(slowThresholdMs);
+    profiler.clear();
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch.hpp>
+
+#include "RotationTracker.h"
+#include "EligiblePlayerFinder.h"
+#include "GameStats.h"
+
+#include <algorithm>
+#include <random>
+
+static QVector<BasePlayerInfo> rotationPlayers(int num) {
+    QVector<BasePlayerInfo> players;
+    for (int i = 0; i < num; i++) {
+        players.push_back(BasePlayerInfo(i + 1, (i % 2 == 0) ? BaseMember::Male : BaseMember::Female, 1 + (i % 4)));
+    }
+    return players;
+}
+
+static std::pair<QVector<MemberId>, QVector<MemberId>> splitEligible(const QVector<PlayerInfo> &players) {
+    QVector<MemberId> mandatory, optional;
+    for (const auto &p : players) {
+        (p.mandatory ? mandatory : optional).push_back(p.memberId);
+    }
+    std::sort(mandatory.begin(), mandatory.end());
+    std::sort(optional.begin(), optional.end());
+    return {mandatory, optional};
+}
+
+TEST_CASE("RotationTracker") {
+    SECTION("First game everyone is eligible") {
+        RotationTracker rotation;
+        for (const auto &p : rotationPlayers(10)) {
+            rotation.setActive(p, true);
+        }
+
+        auto eligible = rotation.findEligiblePlayers(4, 1);
+        REQUIRE(eligible.size() == 10);
+        REQUIRE(std::none_of(eligible.begin(), eligible.end(), [](const PlayerInfo &p) { return p.mandatory; }));
+        REQUIRE(rotation.findEligiblePlayers(0, 1).isEmpty());
+        REQUIRE(rotation.findEligiblePlayers(4, 0).isEmpty());
+    }
+
+    SECTION("Should agree with EligiblePlayerFinder") {
+        auto numPlayers = GENERATE(6, 13, 40, 220);
+        auto numCourts = GENERATE(1u, 3u, 8u);
+        auto players = rotationPlayers(numPlayers);
+
+        std::mt19937 rng(numPlayers * 31 + numCourts);
+        QVector<GameAllocation> pastAllocations;
+        RotationTracker rotation;
+        for (const auto &p : players) {
+            rotation.setActive(p, true);
+        }
+
+        for (GameId gameId = 1; gameId <= 12; gameId++) {
+            auto shuffled = players;
+            std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+            QVector<MemberId> onCourt;
+            for (int i = 0, size = std::min<int>(shuffled.size(), numCourts * 4); i < size; i++) {
+                pastAllocations.push_back(GameAllocation(gameId, i / 4, shuffled[i].memberId, 50));
+                onCourt.push_back(shuffled[i].memberId);
+            }
+            rotation.addGame(onCourt);
+
+            GameStatsImpl stats(pastAllocations);
+            REQUIRE(rotation.numGames() == stats.numGames());
+            for (const auto &p : players) {
+                REQUIRE(rotation.numGamesOff(p.memberId) == stats.numGamesOff(p.memberId));
+                REQUIRE(rotation.numGamesFor(p.memberId) == stats.numGamesFor(p.memberId));
+            }
+
+            REQUIRE(splitEligible(rotation.findEligiblePlayers(4, numCourts)) ==
+                    splitEligible(EligiblePlayerFinder::findEligiblePlayers(players, 4, numCourts, &stats)));
+        }
+
+        RotationTracker replayed(pastAllocations);
+        for (const auto &p : players) {
+            replayed.setActive(p, true);
+        }
+        REQUIRE(splitEligible(replayed.findEligiblePlayers(4, numCourts)) ==
+                splitEligible(rotation.findEligiblePlayers(4, numCourts)));
+    }
+
+    SECTION("Inactive players are not eligible") {
+        auto players = rotationPlayers(8);
+        RotationTracker rotation;
+        for (const auto &p : players) {
+            rotation.setActive(p, true);
+        }
+
+        rotation.addGame({1, 2, 3, 4});
+        REQUIRE(splitEligible(rotation.findEligiblePlayers(4, 1)) ==
+                std::make_pair(QVector<MemberId>{}, QVector<MemberId>{5, 6, 7, 8}));
+
+        rotation.setActive(5, false);
+        REQUIRE(rotation.numActive() == 7);
+        auto [mandatory, optional] = splitEligible(rotation.findEligiblePlayers(4, 1));
+        REQUIRE(mandatory == QVector<MemberId>{6, 7, 8});
+        REQUIRE(optional == QVector<MemberId>{1, 2, 3, 4});
+
+        rotation.setActive(players[4], true);
+        REQUIRE(splitEligible(rotation.findEligiblePlayers(4, 1)) ==
+                std::make_pair(QVector<MemberId>{}, QVector<MemberId>{5, 6, 7, 8}));
+    }
+
+    SECTION("Players come back from a pause with their info") {
+        auto players = rotationPlayers(8);
+        RotationTracker rotation;
+        for (const auto &p : players) {
+            rotation.setActive(p, true);
+        }
+        rotation.addGame({1, 2, 3, 4});
+
+        rotation.setActive(6, false);
+        REQUIRE(!rotation.isActive(6));
+        rotation.setActive(6, true);
+        REQUIRE(rotation.isActive(6));
+        REQUIRE(rotation.numActive() == 8);
+        REQUIRE(splitEligible(rotation.findEligiblePlayers(4, 1)) ==
+                std::make_pair(QVector<MemberId>{}, QVector<MemberId>{5, 6, 7, 8}));
+
+        rotation.setActive(42, true);
+        REQUIRE(!rotation.isActive(42));
+    }
+
+    SECTION("Active players can be set all at once") {
+        auto players = rotationPlayers(8);
+        RotationTracker rotation(QVector<GameAllocation>{
+                GameAllocation(1, 1, 1, 50), GameAllocation(1, 1, 2, 50),
+                GameAllocation(1, 1, 3, 50), GameAllocation(1, 1, 4, 50),
+        });
+        for (const auto &p : players) {
+            rotation.setActive(p, true);
+        }
+
+        rotation.setActivePlayers({players[0], players[1], players[4], players[5], players[6]});
+        REQUIRE(rotation.numActive() == 5);
+        REQUIRE(!rotation.isActive(3));
+        REQUIRE(!rotation.isActive(8));
+
+        auto [mandatory, optional] = splitEligible(rotation.findEligiblePlayers(4, 1));
+        REQUIRE(mandatory == QVector<MemberId>{5, 6, 7});
+        REQUIRE(optional == QVector<MemberId>{1, 2});
+    }
+}
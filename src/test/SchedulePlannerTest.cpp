@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+
+#include "SchedulePlanner.h"
+#include "TestUtils.h"
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+static QVector<Member> plannerPlayers(int num) {
+    QVector<Member> members;
+    for (int i = 0; i < num; i++) {
+        auto m = createMember("First", "Last", (i % 2 == 0) ? Member::Male : Member::Female, 1 + (i % 4));
+        m.id = i + 1;
+        members.push_back(m);
+    }
+    return members;
+}
+
+static int firstRoundWith(const QVector<SchedulePlanner::Round> &rounds, MemberId memberId) {
+    for (int i = 0; i < rounds.size(); i++) {
+        for (const auto &allocation : rounds[i]) {
+            if (allocation.memberId == memberId) return i;
+        }
+    }
+    return -1;
+}
+
+TEST_CASE("SchedulePlanner") {
+    const QVector<CourtId> courts = {1, 2};
+    const GameId lastGameId = 1;
+    auto players = plannerPlayers(12);
+
+    QVector<GameAllocation> pastAllocations;
+    for (int i = 0; i < 8; i++) {
+        pastAllocations.push_back(GameAllocation(lastGameId, courts[i / 4], players[i].id, 50));
+    }
+
+    auto rounds = SchedulePlanner::plan(pastAllocations, {}, players, courts, 4, 3, 4, 1);
+
+    SECTION("Plan should be fair over the rounds") {
+        REQUIRE(rounds.size() == 3);
+
+        QHash<MemberId, int> numGames;
+        for (const auto &allocation : pastAllocations) {
+            numGames[allocation.memberId]++;
+        }
+
+        for (const auto &round : rounds) {
+            REQUIRE(round.size() == 8);
+            for (const auto &allocation : round) {
+                numGames[allocation.memberId]++;
+            }
+        }
+
+        int minGames = numGames.value(players.first().id), maxGames = minGames;
+        for (const auto &player : players) {
+            minGames = std::min(minGames, numGames.value(player.id));
+            maxGames = std::max(maxGames, numGames.value(player.id));
+        }
+        REQUIRE(maxGames - minGames <= 1);
+    }
+
+    SECTION("Planning keeps the rounds already planned") {
+        auto extended = SchedulePlanner::plan(pastAllocations, rounds.mid(0, 2), players, courts, 4, 3, 4, 2);
+        REQUIRE(extended.size() == 3);
+        REQUIRE(extended.mid(0, 2) == rounds.mid(0, 2));
+    }
+
+    SECTION("A cancelled plan only keeps the rounds already planned") {
+        std::atomic<bool> cancelled = true;
+        auto kept = SchedulePlanner::plan(pastAllocations, rounds.mid(0, 1), players, courts, 4, 3, 4, 2,
+                                          nullptr, &cancelled);
+        REQUIRE(kept == rounds.mid(0, 1));
+    }
+
+    SECTION("Planning from the global pool doesn't wait on itself") {
+        // Every global pool thread plans at once, each waiting for candidates of its own
+        QVector<QFuture<QVector<SchedulePlanner::Round>>> plans;
+        for (int i = 0; i < QThreadPool::globalInstance()->maxThreadCount(); i++) {
+            plans.push_back(QtConcurrent::run([&, i] {
+                return SchedulePlanner::plan(pastAllocations, {}, players, courts, 4, 3, 4, i);
+            }));
+        }
+
+        for (auto &plan : plans) {
+            REQUIRE(plan.result().size() == 3);
+        }
+    }
+
+    SchedulePlanner planner;
+    planner.setPlan(lastGameId, players, courts, rounds);
+
+    SECTION("Next round should follow the plan") {
+        auto next = planner.nextRound(lastGameId, players, courts);
+        REQUIRE(next);
+        REQUIRE(*next == rounds.first());
+
+        planner.roundStarted(lastGameId + 1);
+        REQUIRE(planner.rounds() == rounds.mid(1));
+        REQUIRE(planner.nextRound(lastGameId + 1, players, courts) == rounds[1]);
+    }
+
+    SECTION("Games outside the plan invalidate everything") {
+        REQUIRE(!planner.nextRound(lastGameId + 1, players, courts));
+        REQUIRE(planner.rounds().isEmpty());
+    }
+
+    SECTION("Changing courts invalidates everything") {
+        REQUIRE(planner.invalidate(lastGameId, players, {1}) == 0);
+    }
+
+    SECTION("Newcomers invalidate everything") {
+        auto withNewcomer = plannerPlayers(13);
+        REQUIRE(planner.invalidate(lastGameId, withNewcomer, courts) == 0);
+    }
+
+    SECTION("Leaving players only invalidate the rounds they are in") {
+        auto leaving = players.last();
+        auto remaining = players.mid(0, players.size() - 1);
+        auto firstAffected = firstRoundWith(rounds, leaving.id);
+        REQUIRE(firstAffected >= 0);
+
+        REQUIRE(planner.invalidate(lastGameId, remaining, courts) == firstAffected);
+        REQUIRE(planner.rounds() == rounds.mid(0, firstAffected));
+        REQUIRE(planner.invalidate(lastGameId, remaining, courts) == firstAffected);
+    }
+
+    SECTION("Level changes count as leaving") {
+        auto changed = players;
+        changed[0].level += 1;
+        REQUIRE(planner.invalidate(lastGameId, changed, courts) == firstRoundWith(rounds, changed[0].id));
+    }
+}